@@ -13,27 +13,162 @@ typedef enum {
 	IJXML_TYPE_FORCEINT = 65536    /* Makes sure this enum is signed 32bit. */
 } ijxmltype_t;
 
+#if defined(IJXML_NAMESPACES)
+	#define IJXML_NS_NONE		((unsigned)-1)	/* unprefixed attributes, elements without a default namespace */
+	#define IJXML_NS_XML		((unsigned)-2)	/* the implicitly bound 'xml' prefix */
+	#define IJXML_NS_XMLNS		((unsigned)-3)	/* namespace declarations ('xmlns' and 'xmlns:*' attributes) */
+	#define IJXML_NS_UNKNOWN	((unsigned)-4)	/* a URI the document never declares, no token carries it */
+
+typedef struct ijxml_ns_binding {
+	unsigned prefix_start;
+	unsigned prefix_end;
+	unsigned ns;
+	unsigned object;
+} ijxml_ns_binding;
+
+typedef struct ijxml_ns_uri {
+	unsigned start;
+	unsigned end;
+} ijxml_ns_uri;
+
+/* caller owned storage for the in-scope prefix bindings and the interned namespace URIs.
+ * namespace ids are indices into 'uris' and stay valid after parsing is done. */
+typedef struct ijxml_ns_context {
+	struct ijxml_ns_binding *bindings;
+	unsigned num_bindings;
+	unsigned max_bindings;
+
+	struct ijxml_ns_uri *uris;
+	unsigned num_uris;
+	unsigned max_uris;
+} ijxml_ns_context;
+#endif
+
 typedef struct ijxml_token {
 	ijxmltype_t type;
 	unsigned start;
 	unsigned end;
 	unsigned size;
 	unsigned parent;
+#if defined(IJXML_NAMESPACES)
+	unsigned local;		/* start of the local name, equals 'start' when there is no prefix */
+	unsigned ns;		/* resolved namespace id for tag names and attribute keys */
+#endif
 } ijxml_token;
 
+typedef enum {
+	IJXML_ENCODING_UTF8,
+	IJXML_ENCODING_UTF16LE,
+	IJXML_ENCODING_UTF16BE
+} ijxml_encoding_t;
+
+/* ijxml_parse_result.error */
+typedef enum {
+	IJXML_PARSE_SUCCESS = 0,
+	IJXML_PARSE_ERROR = 1,		/* out of tokens or malformed */
+	IJXML_PARSE_YIELD = 2		/* budget used up, call again to continue */
+} ijxml_parse_status_t;
+
 typedef struct ijxml_parse_result {
 	int error;
 } ijxml_parse_result;
 
+typedef struct ijxml_record {
+	unsigned start;
+	unsigned end;
+} ijxml_record;
+
+/* receives the output of ijxml_canonicalize and ijxml_escape, returns 0 on failure */
+typedef int (*ijxml_output_fn)(void *user, const char *data, unsigned len);
+
+typedef enum {
+	IJXML_CANONICAL_SORT_ATTRIBUTES = 1
+} ijxml_canonical_flags_t;
+
+/* ijxml_canonicalize results */
+typedef enum {
+	IJXML_CANONICAL_SUCCESS = 0,
+	IJXML_CANONICAL_MALFORMED = 1,
+	IJXML_CANONICAL_TOO_MANY_ATTRIBUTES = 2,
+	IJXML_CANONICAL_OUTPUT_FAILED = 3
+} ijxml_canonical_status_t;
+
+/* attributes of one element that can be sorted, define before including to override */
+#if !defined(IJXML_CANONICAL_MAX_ATTRIBUTES)
+	#define IJXML_CANONICAL_MAX_ATTRIBUTES 32
+#endif
+
+/* FNV-1a, 32 bit by default. Define IJXML_HASH64 before including (in every file) for 64 bit hashes, 32 bit ones
+ * start to collide after about 2^16 distinct documents */
+#if defined(IJXML_HASH64)
+	typedef unsigned long long ijxml_hash_t;
+	#define IJXML_HASH_SEED		14695981039346656037ull
+	#define IJXML_HASH_PRIME	1099511628211ull
+#else
+	typedef unsigned ijxml_hash_t;
+	#define IJXML_HASH_SEED		2166136261u
+	#define IJXML_HASH_PRIME	16777619u
+#endif
+
 typedef struct ijxml_parser {
 	unsigned pos;
 	unsigned toknext;
 	unsigned toksuper;
+	int yielded;
+#if defined(IJXML_NAMESPACES)
+	struct ijxml_ns_context *ns;
+#endif
 } ijxml_parser;
 
 void ijxml_parser_init(struct ijxml_parser *parser);
+#if defined(IJXML_NAMESPACES)
+/* same as ijxml_parser_init but also resolves namespace prefixes using the supplied storage */
+void ijxml_parser_init_ns(struct ijxml_parser *parser, struct ijxml_ns_context *ns, struct ijxml_ns_binding *bindings, unsigned max_bindings, struct ijxml_ns_uri *uris, unsigned max_uris);
+#endif
 struct ijxml_parse_result ijxml_parse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens);
 
+/* Like ijxml_parse but returns IJXML_PARSE_YIELD once about 'max_bytes' bytes were consumed or 'max_tokens' tokens
+ * were allocated by this call (budgets are checked between elements, strings and text runs, a single one may overshoot).
+ * Calling ijxml_parse_budget or ijxml_parse again continues from the same byte without rescanning anything.
+ * Time budgets are left to the caller, e.g. by adapting 'max_bytes' to the measured throughput. */
+struct ijxml_parse_result ijxml_parse_budget(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned max_bytes, unsigned max_tokens);
+
+/* Finds the next top-level element in xml[*pos, xml_len) by tracking element depth, without tokenizing. Meant for streams
+ * of root elements such as logs: each record can be parsed on its own (a fresh parser on xml + record->start, reusing
+ * one token buffer), or records can be collected and handed out to worker threads, the scan itself keeps no state.
+ * Returns 1 and advances *pos past the record, 0 if no further element follows (*pos moves to the end) and
+ * -1 if the data ends inside a record (*pos is left unchanged so the rest can be scanned again with more data). */
+int ijxml_next_record(const char *xml, unsigned xml_len, unsigned *pos, struct ijxml_record *record);
+
+/* FNV-1a of 'data', continuing from 'hash' (IJXML_HASH_SEED for the first chunk) */
+ijxml_hash_t ijxml_hash(ijxml_hash_t hash, const char *data, unsigned len);
+
+/* Writes 'text' with '&', '<', '>' and '"' replaced by entities. Returns 0 if 'output' failed. */
+int ijxml_escape(const char *text, unsigned len, ijxml_output_fn output, void *user);
+
+/* Writes a minified, normalized copy of 'xml' to 'output' in a single scan, no tokens are needed.
+ * Comments, processing instructions (the XML declaration included) and DOCTYPEs are dropped, whitespace only text
+ * is dropped, tags lose their insignificant whitespace, attribute values are double quoted, CDATA sections become
+ * escaped text and elements without content are written as '<name/>'. Entities and the text itself are left as they
+ * are, this is not W3C canonical XML. If 'hash' is set it receives ijxml_hash of the output.
+ * End tags are not matched by name, but more end tags than start tags or elements left open are malformed.
+ * Returns an ijxml_canonical_status_t. */
+int ijxml_canonicalize(const char *xml, unsigned xml_len, unsigned flags, ijxml_output_fn output, void *user, ijxml_hash_t *hash);
+
+/* Detects the encoding from the byte order mark, or from the leading '<' of an unmarked UTF-16 document.
+ * 'bom_len' receives the size of the byte order mark. ijxml_parse skips a UTF-8 mark by itself. */
+ijxml_encoding_t ijxml_detect_encoding(const char *data, unsigned len, unsigned *bom_len);
+
+/* Converts UTF-16 without byte order mark to UTF-8 for parsing. Writes at most 'buffer_size' bytes and returns the
+ * size of the complete conversion. 'error' is set for odd lengths and unpaired surrogates. */
+unsigned ijxml_utf16_to_utf8(const char *data, unsigned len, ijxml_encoding_t encoding, char *buffer, unsigned buffer_size, int *error);
+
+/* Updates the tokens of a completely parsed document after the bytes [edit_start, edit_start+removed_len) were replaced
+ * by 'inserted_len' new bytes. 'xml' and 'xml_len' describe the edited document. Only the smallest object enclosing the
+ * edit is tokenized again (in the unused tail of 'tokens'), later tokens are shifted and relinked.
+ * On error the tokens are left untouched and the document has to be parsed from scratch. */
+struct ijxml_parse_result ijxml_reparse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned edit_start, unsigned removed_len, unsigned inserted_len);
+
 #endif // _IJXML_H_
 
 #if defined(IJXML_IMPLEMENTATION)
@@ -45,7 +180,28 @@ void ijxml_parser_init(struct ijxml_parser *parser)
 {
 	parser->pos = parser->toknext = 0u;
 	parser->toksuper = IJXML__NO_TOKEN_SUPER;
+	parser->yielded = 0;
+#if defined(IJXML_NAMESPACES)
+	parser->ns = 0;
+#endif
+}
+
+#if defined(IJXML_NAMESPACES)
+void ijxml_parser_init_ns(struct ijxml_parser *parser, struct ijxml_ns_context *ns, struct ijxml_ns_binding *bindings, unsigned max_bindings, struct ijxml_ns_uri *uris, unsigned max_uris)
+{
+	ijxml_parser_init(parser);
+
+	ns->bindings = bindings;
+	ns->num_bindings = 0u;
+	ns->max_bindings = max_bindings;
+
+	ns->uris = uris;
+	ns->num_uris = 0u;
+	ns->max_uris = max_uris;
+
+	parser->ns = ns;
 }
+#endif
 
 static struct ijxml_token *ijxml__allocate_token(struct ijxml_parser *parser, struct ijxml_token *tokens, unsigned num_tokens)
 {
@@ -58,6 +214,10 @@ static struct ijxml_token *ijxml__allocate_token(struct ijxml_parser *parser, st
 	tok->start = tok->end = IJXML__TOKEN_INVALID_OFFSET;
 	tok->size = 0u;
 	tok->parent = IJXML__NO_TOKEN_SUPER;
+#if defined(IJXML_NAMESPACES)
+	tok->local = IJXML__TOKEN_INVALID_OFFSET;
+	tok->ns = IJXML_NS_NONE;
+#endif
 
 	return tok;
 }
@@ -68,6 +228,10 @@ static void ijxml__token_fill(struct ijxml_token *tok, unsigned start_pos, unsig
 	tok->end = end_pos;
 	tok->type = xml_type;
 	tok->size = 0u;
+#if defined(IJXML_NAMESPACES)
+	tok->local = start_pos;
+	tok->ns = IJXML_NS_NONE;
+#endif
 }
 
 static unsigned ijxml__string_len(const char *s)
@@ -162,12 +326,133 @@ static void ijxml__skip_whitespaces(struct ijxml_parser *parser, const char *xml
 	}
 }
 
+#define IJXML__INVALID_CODEPOINT		((unsigned)-1)
+
+/* decodes the multi-byte sequence whose lead byte is at *pos, leaving *pos on its last byte.
+ * rejects truncated, overlong and surrogate encodings as well as code points past U+10FFFF. */
+static unsigned ijxml__decode_utf8(const char *xml, unsigned xml_len, unsigned *pos)
+{
+	static const unsigned min_codepoint[4] = { 0x0u, 0x80u, 0x800u, 0x10000u };
+	unsigned char c = (unsigned char)xml[*pos];
+	unsigned codepoint, num_continuation, i;
+
+	if (c >= 0xF0 && c <= 0xF4) {
+		codepoint = c & 0x07u, num_continuation = 3;
+	} else if (c >= 0xE0) {
+		codepoint = c & 0x0Fu, num_continuation = 2;
+	} else if (c >= 0xC2) {
+		codepoint = c & 0x1Fu, num_continuation = 1;
+	} else {
+		return IJXML__INVALID_CODEPOINT;
+	}
+
+	if (c > 0xF4 || *pos + num_continuation >= xml_len)
+		return IJXML__INVALID_CODEPOINT;
+
+	for (i=1; i <= num_continuation; ++i) {
+		c = (unsigned char)xml[*pos + i];
+		if ((c & 0xC0u) != 0x80u)
+			return IJXML__INVALID_CODEPOINT;
+
+		codepoint = (codepoint << 6) | (c & 0x3Fu);
+	}
+
+	if (codepoint < min_codepoint[num_continuation] || codepoint > 0x10FFFFu || (codepoint >= 0xD800u && codepoint <= 0xDFFFu))
+		return IJXML__INVALID_CODEPOINT;
+
+	*pos += num_continuation;
+
+	return codepoint;
+}
+
+/* XML NameStartChar / NameChar for non-ASCII code points, ASCII names are checked as before */
+static int ijxml__is_name_codepoint(unsigned c, int first)
+{
+	if ((c >= 0xC0u && c <= 0xD6u) || (c >= 0xD8u && c <= 0xF6u) || (c >= 0xF8u && c <= 0x2FFu) ||
+		(c >= 0x370u && c <= 0x37Du) || (c >= 0x37Fu && c <= 0x1FFFu) || (c >= 0x200Cu && c <= 0x200Du) ||
+		(c >= 0x2070u && c <= 0x218Fu) || (c >= 0x2C00u && c <= 0x2FEFu) || (c >= 0x3001u && c <= 0xD7FFu) ||
+		(c >= 0xF900u && c <= 0xFDCFu) || (c >= 0xFDF0u && c <= 0xFFFDu) || (c >= 0x10000u && c <= 0xEFFFFu))
+		return 1;
+
+	if (first)
+		return 0;
+
+	return (c == 0xB7u || (c >= 0x300u && c <= 0x36Fu) || (c >= 0x203Fu && c <= 0x2040u));
+}
+
+#define IJXML__SWAR_ONES		0x01010101u
+#define IJXML__SWAR_HIGHS		0x80808080u
+#define IJXML__SWAR_HAS_ZERO(w)	(((w) - IJXML__SWAR_ONES) & ~(w) & IJXML__SWAR_HIGHS)
+
+static unsigned ijxml__load_word(const char *xml, unsigned pos)
+{
+	const unsigned char *s = (const unsigned char *)xml + pos;
+
+	return (unsigned)s[0] | ((unsigned)s[1] << 8) | ((unsigned)s[2] << 16) | ((unsigned)s[3] << 24);
+}
+
+#define IJXML__SWAR_SPECIALS(w)	(IJXML__SWAR_HAS_ZERO(w) | IJXML__SWAR_HAS_ZERO((w) ^ (IJXML__SWAR_ONES * '\"')) | IJXML__SWAR_HAS_ZERO((w) ^ (IJXML__SWAR_ONES * '\\')))
+
+/* skips four bytes at a time over string content needing no attention: no quote, backslash or terminator
+ * (and only well formed sequences when validating UTF-8). returns the position of the first byte to look at. */
+static unsigned ijxml__skip_string_run(const char *xml, unsigned pos, unsigned xml_len)
+{
+	unsigned w;
+#if defined(IJXML_VALIDATE_UTF8)
+	unsigned highs, ascii_len, next;
+#endif
+
+	while (pos + 4 <= xml_len) {
+		w = ijxml__load_word(xml, pos);
+
+#if defined(IJXML_VALIDATE_UTF8)
+		highs = w & IJXML__SWAR_HIGHS;
+		if (highs) {
+			/* ASCII in front of the first non-ASCII byte, the flags of bytes below it are exact */
+			ascii_len = (highs & 0x80u) ? 0 : (highs & 0x8000u) ? 1 : (highs & 0x800000u) ? 2 : 3;
+			if (ascii_len) {
+				if (IJXML__SWAR_SPECIALS(w) & ((1u << (8*ascii_len)) - 1u))
+					break;
+
+				pos += ascii_len;
+				continue;
+			}
+
+			/* two 2 byte sequences (C2..DF 80..BF), e.g. Latin, Greek or Cyrillic text */
+			if ((w & 0xC0E0C0E0u) == 0x80C080C0u && (w & 0x001E0000u) && (w & 0x0000001Eu)) {
+				pos += 4;
+				continue;
+			}
+
+			/* 3 byte sequence with a lead byte allowing any continuation (E1..EC, EE..EF), e.g. CJK text */
+			if ((w & 0x00C0C0F0u) == 0x008080E0u && (w & 0xFFu) != 0xE0u && (w & 0xFFu) != 0xEDu) {
+				pos += 3;
+				continue;
+			}
+
+			next = pos;
+			if (ijxml__decode_utf8(xml, xml_len, &next) == IJXML__INVALID_CODEPOINT)
+				break;
+
+			pos = next + 1;
+			continue;
+		}
+#endif
+		if (IJXML__SWAR_SPECIALS(w))
+			break;
+
+		pos += 4;
+	}
+
+	return pos;
+}
+
 static void ijxml__parse_string(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, ijxmltype_t xml_type, struct ijxml_parse_result *res)
 {
 	struct ijxml_token *token;
 	unsigned start = parser->pos++; // skip "
 
-	for (; parser->pos < xml_len && xml[parser->pos] != '\0'; parser->pos++) {
+	for (; (parser->pos = ijxml__skip_string_run(xml, parser->pos, xml_len)) < xml_len && xml[parser->pos] != '\0'; parser->pos++) {
 		char c = xml[parser->pos];
 
 		if (c == '\"') {
@@ -194,6 +479,11 @@ static void ijxml__parse_string(struct ijxml_parser *parser, const char *xml, un
 					goto string_parse_fail;
 			}
 		}
+
+#if defined(IJXML_VALIDATE_UTF8)
+		if ((unsigned char)c >= 0x80 && ijxml__decode_utf8(xml, xml_len, &parser->pos) == IJXML__INVALID_CODEPOINT)
+			goto string_parse_fail;
+#endif
 	}
 
 string_parse_fail:
@@ -205,15 +495,43 @@ static void ijxml__parse_key(struct ijxml_parser *parser, const char *xml, unsig
 {
 	struct ijxml_token *token;
 	unsigned start = parser->pos;
+#if defined(IJXML_NAMESPACES)
+	unsigned local = start;
+#endif
 
 	for (; parser->pos < xml_len && xml[parser->pos] != '\0'; parser->pos++) {
 		switch (xml[parser->pos]) {
 			case '\t' : case '\r' : case '\n' : case ' ' :
 			case '\\' : case '>' : case '<' : case '=' :
 				goto found;
+			case '/' :
+				/* ends names in self-closing tags, text may contain it */
+				if (xml_type != IJXML_VALUE)
+					goto found;
+				break;
+#if defined(IJXML_NAMESPACES)
+			case ':' :
+				if (local == start)
+					local = parser->pos+1;
+				break;
+#endif
 		}
 
-		if (xml[parser->pos] < 32 || xml[parser->pos] >= 127) {
+		if ((unsigned char)xml[parser->pos] >= 0x80) {
+			int first = (parser->pos == start);
+			unsigned codepoint = ijxml__decode_utf8(xml, xml_len, &parser->pos);
+
+			/* text takes any character, names follow the XML name production */
+			if (codepoint == IJXML__INVALID_CODEPOINT || (xml_type != IJXML_VALUE && !ijxml__is_name_codepoint(codepoint, first))) {
+				parser->pos = start;
+				res->error = 1;
+				return;
+			}
+
+			continue;
+		}
+
+		if (xml[parser->pos] < 32 || xml[parser->pos] == 127) {
 			parser->pos = start;
 			res->error = 1;
 			return;
@@ -229,6 +547,10 @@ found:
 	}
 
 	ijxml__token_fill(token, start, parser->pos, xml_type);
+#if defined(IJXML_NAMESPACES)
+	if (xml_type != IJXML_VALUE)
+		token->local = local;
+#endif
 
 	token->parent = parser->toksuper;
 }
@@ -269,9 +591,161 @@ static void ijxml__parse_attributes(struct ijxml_parser *parser, const char *xml
 	}
 }
 
-static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens)
+#if defined(IJXML_NAMESPACES)
+static int ijxml__span_equals(const char *xml, unsigned a_start, unsigned a_end, const char *b, unsigned b_len)
+{
+	const char *a = xml + a_start;
+
+	if (a_end - a_start != b_len)
+		return 0;
+
+	while (b_len--) {
+		if (*a++ != *b++)
+			return 0;
+	}
+
+	return 1;
+}
+
+static unsigned ijxml__ns_intern(struct ijxml_ns_context *ns, const char *xml, struct ijxml_token *value, struct ijxml_parse_result *res)
+{
+	unsigned i;
+	struct ijxml_ns_uri *uri;
+
+	for (i=0; i != ns->num_uris; ++i) {
+		uri = &ns->uris[i];
+		if (ijxml__span_equals(xml, uri->start, uri->end, xml + value->start, value->end - value->start))
+			return i;
+	}
+
+	if (ns->num_uris == ns->max_uris) {
+		res->error = 1;
+		return IJXML_NS_NONE;
+	}
+
+	uri = &ns->uris[ns->num_uris];
+	uri->start = value->start;
+	uri->end = value->end;
+
+	return ns->num_uris++;
+}
+
+static unsigned ijxml__ns_lookup(struct ijxml_ns_context *ns, const char *xml, unsigned prefix_start, unsigned prefix_end, struct ijxml_parse_result *res)
+{
+	unsigned i = ns->num_bindings;
+	struct ijxml_ns_binding *binding;
+
+	if (ijxml__span_equals(xml, prefix_start, prefix_end, "xml", 3))
+		return IJXML_NS_XML;
+
+	while (i--) {
+		binding = &ns->bindings[i];
+		if (ijxml__span_equals(xml, binding->prefix_start, binding->prefix_end, xml + prefix_start, prefix_end - prefix_start))
+			return binding->ns;
+	}
+
+	/* no default namespace in scope is fine, an undeclared prefix is not */
+	if (prefix_start != prefix_end)
+		res->error = 1;
+
+	return IJXML_NS_NONE;
+}
+
+/* pushes a binding for every namespace declaration among the attributes of 'object_index' */
+static void ijxml__ns_declare(struct ijxml_parser *parser, const char *xml, struct ijxml_token *tokens, unsigned object_index, struct ijxml_parse_result *res)
+{
+	struct ijxml_ns_context *ns = parser->ns;
+	struct ijxml_ns_binding *binding;
+	struct ijxml_token *key;
+	unsigned i;
+
+	for (i=object_index+2; i+1 < parser->toknext; i += 2) {
+		key = &tokens[i];
+
+		if (key->type != IJXML_ATTRIBUTE_KEY || key->parent != object_index)
+			break;
+
+		if (ijxml__span_equals(xml, key->start, key->end, "xmlns", 5)) {
+			/* default namespace, prefix is the empty span */
+		} else if (key->local != key->start && ijxml__span_equals(xml, key->start, key->local-1, "xmlns", 5)) {
+			/* prefixed declaration */
+		} else {
+			continue;
+		}
+
+		if (ns->num_bindings == ns->max_bindings) {
+			res->error = 1;
+			return;
+		}
+
+		binding = &ns->bindings[ns->num_bindings++];
+		binding->prefix_start = (key->local == key->start ? key->end : key->local);
+		binding->prefix_end = key->end;
+		binding->object = object_index;
+		/* xmlns="" undeclares the default namespace */
+		binding->ns = (key[1].start == key[1].end ? IJXML_NS_NONE : ijxml__ns_intern(ns, xml, &key[1], res));
+		key->ns = IJXML_NS_XMLNS;
+
+		if (res->error != 0)
+			return;
+	}
+}
+
+/* called once the attributes of 'object_index' are tokenized as the element's own declarations are in scope for its name */
+static void ijxml__ns_resolve(struct ijxml_parser *parser, const char *xml, struct ijxml_token *tokens, unsigned object_index, struct ijxml_parse_result *res)
+{
+	struct ijxml_ns_context *ns = parser->ns;
+	struct ijxml_token *key;
+	unsigned i;
+
+	ijxml__ns_declare(parser, xml, tokens, object_index, res);
+	if (res->error != 0)
+		return;
+
+	for (i=object_index+1; i < parser->toknext; ++i) {
+		key = &tokens[i];
+
+		if (key->type == IJXML_ATTRIBUTE_VALUE || key->ns == IJXML_NS_XMLNS)
+			continue;
+
+		if (key->local != key->start)
+			key->ns = ijxml__ns_lookup(ns, xml, key->start, key->local-1, res);
+		else if (key->type == IJXML_TAG_NAME)
+			key->ns = ijxml__ns_lookup(ns, xml, key->start, key->start, res);
+
+		if (res->error != 0)
+			return;
+	}
+}
+
+/* rebuilds the bindings in scope for the children of 'object_index', outermost first */
+static void ijxml__ns_push_scope(struct ijxml_parser *parser, const char *xml, struct ijxml_token *tokens, unsigned object_index, struct ijxml_parse_result *res)
+{
+	if (object_index == IJXML__NO_TOKEN_SUPER)
+		return;
+
+	ijxml__ns_push_scope(parser, xml, tokens, tokens[object_index].parent, res);
+	if (res->error == 0)
+		ijxml__ns_declare(parser, xml, tokens, object_index, res);
+}
+
+static void ijxml__ns_pop(struct ijxml_parser *parser, unsigned object_index)
+{
+	struct ijxml_ns_context *ns = parser->ns;
+
+	if (!ns)
+		return;
+
+	while (ns->num_bindings && ns->bindings[ns->num_bindings-1].object >= object_index)
+		--ns->num_bindings;
+}
+#endif
+
+static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned max_bytes, unsigned max_tokens)
 {
 	struct ijxml_parse_result result;
+	unsigned pos_limit = (parser->pos + max_bytes < parser->pos) ? (unsigned)-1 : parser->pos + max_bytes;
+	unsigned token_limit = (parser->toknext + max_tokens < parser->toknext) ? (unsigned)-1 : parser->toknext + max_tokens;
 
 	result.error = 0;
 
@@ -334,6 +808,10 @@ static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const
 							break;
 
 						ijxml__parse_attributes(parser, xml, xml_len, tokens, num_tokens, &result);
+#if defined(IJXML_NAMESPACES)
+						if (result.error == 0 && parser->ns)
+							ijxml__ns_resolve(parser, xml, tokens, (unsigned)(object_token - tokens), &result);
+#endif
 					} // default
 				} // switch c2
 					
@@ -358,6 +836,8 @@ static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const
 
 					if (result.error != 0)
 						break;
+				} else {
+					++parser->pos;	/* objects always end past their closing '>' */
 				}
 
 				{
@@ -370,6 +850,9 @@ static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const
 							}
 							token->end = parser->pos;
 							parser->toksuper = token->parent;
+#if defined(IJXML_NAMESPACES)
+							ijxml__ns_pop(parser, (unsigned)(token - tokens));
+#endif
 							break;
 						}
 
@@ -393,16 +876,461 @@ static struct ijxml_parse_result ijxml__parse(struct ijxml_parser *parser, const
 				ijxml__parse_key(parser, xml, xml_len, tokens, num_tokens, IJXML_VALUE, &result);
 			}
 		}
+
+		/* budgets are checked between constructs, the parser state is then exactly where the next one begins */
+		if (result.error == 0 && (parser->pos >= pos_limit || parser->toknext >= token_limit) && parser->pos < xml_len && xml[parser->pos] != '\0') {
+			result.error = IJXML_PARSE_YIELD;
+			parser->yielded = 1;
+		}
 	}
 
 	return result;
 }
 
-struct ijxml_parse_result ijxml_parse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens)
+/* position of the first 'c' in xml[pos, xml_len), xml_len if there is none */
+static unsigned ijxml__find_char(const char *xml, unsigned pos, unsigned xml_len, char c)
+{
+	unsigned pattern = IJXML__SWAR_ONES * (unsigned char)c;
+
+	while (pos + 4 <= xml_len && !IJXML__SWAR_HAS_ZERO(ijxml__load_word(xml, pos) ^ pattern))
+		pos += 4;
+
+	while (pos < xml_len && xml[pos] != c)
+		++pos;
+
+	return pos;
+}
+
+/* position past the first occurrence of 'terminator' at or after 'pos', IJXML__TOKEN_INVALID_OFFSET if there is none */
+static unsigned ijxml__skip_past(const char *xml, unsigned pos, unsigned xml_len, const char *terminator)
+{
+	const char *end = xml + xml_len;
+
+	for (;;) {
+		pos = ijxml__find_char(xml, pos, xml_len, terminator[0]);
+		if (pos == xml_len)
+			return IJXML__TOKEN_INVALID_OFFSET;
+
+		if (ijxml__string_starts_with(xml + pos, terminator, end))
+			return pos + ijxml__string_len(terminator);
+
+		++pos;
+	}
+}
+
+/* position past the '<!...>' declaration at 'pos', IJXML__TOKEN_INVALID_OFFSET if it is not closed.
+ * the internal subset of a DOCTYPE is bracketed and may contain '>' */
+static unsigned ijxml__skip_declaration(const char *xml, unsigned pos, unsigned xml_len)
+{
+	unsigned depth = 0u;
+
+	for (pos += 2; pos < xml_len; ++pos) {
+		if (xml[pos] == '[')
+			++depth;
+		else if (xml[pos] == ']' && depth)
+			--depth;
+		else if (xml[pos] == '>' && depth == 0u)
+			return pos + 1;
+	}
+
+	return IJXML__TOKEN_INVALID_OFFSET;
+}
+
+int ijxml_next_record(const char *xml, unsigned xml_len, unsigned *pos, struct ijxml_record *record)
+{
+	unsigned p = *pos, depth = 0u, start = 0u;
+	const char *end = xml + xml_len;
+	char quote;
+
+	for (;;) {
+		p = ijxml__find_char(xml, p, xml_len, '<');
+		if (p == xml_len)
+			break;
+
+		if (p + 1 == xml_len)
+			return -1;
+
+		switch (xml[p+1]) {
+			case '?' :
+				p = ijxml__skip_past(xml, p+2, xml_len, "?>");
+				if (p == IJXML__TOKEN_INVALID_OFFSET)
+					return -1;
+				break;
+
+			case '!' :
+				if (ijxml__string_starts_with(xml + p, "<!--", end))
+					p = ijxml__skip_past(xml, p+4, xml_len, "-->");
+				else if (ijxml__string_starts_with(xml + p, "<![CDATA[", end))
+					p = ijxml__skip_past(xml, p+9, xml_len, "]]>");
+				else
+					p = ijxml__skip_declaration(xml, p, xml_len);
+
+				if (p == IJXML__TOKEN_INVALID_OFFSET)
+					return -1;
+				break;
+
+			case '/' :
+				p = ijxml__skip_past(xml, p+2, xml_len, ">");
+				if (p == IJXML__TOKEN_INVALID_OFFSET)
+					return -1;
+
+				if (depth == 0u)
+					break;	/* stray end tag between records */
+
+				if (--depth == 0u) {
+					record->start = start;
+					record->end = p;
+					*pos = p;
+					return 1;
+				}
+				break;
+
+			default : {
+				unsigned tag_start = p;
+
+				/* quoted attribute values may contain '>' */
+				for (++p, quote = 0; p < xml_len; ++p) {
+					if (quote) {
+						if (xml[p] == quote)
+							quote = 0;
+					} else if (xml[p] == '"' || xml[p] == '\'') {
+						quote = xml[p];
+					} else if (xml[p] == '>') {
+						break;
+					}
+				}
+
+				if (p == xml_len)
+					return -1;
+
+				if (depth == 0u)
+					start = tag_start;
+
+				if (xml[p-1] != '/') {
+					++depth;
+				} else if (depth == 0u) {
+					record->start = start;
+					record->end = p+1;
+					*pos = p+1;
+					return 1;
+				}
+
+				++p;
+			}
+		}
+
+		if (p >= xml_len)
+			break;
+	}
+
+	if (depth != 0u)
+		return -1;
+
+	*pos = xml_len;
+
+	return 0;
+}
+
+ijxml_hash_t ijxml_hash(ijxml_hash_t hash, const char *data, unsigned len)
+{
+	const unsigned char *s = (const unsigned char *)data, *end = s + len;
+
+	while (s != end)
+		hash = (hash ^ *s++) * IJXML_HASH_PRIME;
+
+	return hash;
+}
+
+int ijxml_escape(const char *text, unsigned len, ijxml_output_fn output, void *user)
+{
+	const char *run = text, *end = text + len, *entity;
+
+	for (; text != end; ++text) {
+		switch (*text) {
+			case '&' : entity = "&amp;"; break;
+			case '<' : entity = "&lt;"; break;
+			case '>' : entity = "&gt;"; break;
+			case '"' : entity = "&quot;"; break;
+			default: continue;
+		}
+
+		if ((text != run && !output(user, run, (unsigned)(text - run))) || !output(user, entity, ijxml__string_len(entity)))
+			return 0;
+
+		run = text + 1;
+	}
+
+	return run == end || output(user, run, (unsigned)(end - run));
+}
+
+typedef struct ijxml__canonical_output {
+	ijxml_output_fn output;
+	void *user;
+	ijxml_hash_t *hash;
+	int failed;
+	int open_tag;		/* '<name ...' written, '>' or '/>' still pending */
+} ijxml__canonical_output;
+
+typedef struct ijxml__canonical_attribute {
+	unsigned key, key_len;
+	unsigned value, value_len;
+} ijxml__canonical_attribute;
+
+static int ijxml__canonical_emit(void *user, const char *data, unsigned len)
+{
+	struct ijxml__canonical_output *out = (struct ijxml__canonical_output *)user;
+
+	if (out->failed || len == 0)
+		return !out->failed;
+
+	if (out->hash)
+		*out->hash = ijxml_hash(*out->hash, data, len);
+
+	if (!out->output(out->user, data, len))
+		out->failed = 1;
+
+	return !out->failed;
+}
+
+static void ijxml__canonical_close_tag(struct ijxml__canonical_output *out)
+{
+	if (out->open_tag) {
+		ijxml__canonical_emit(out, ">", 1);
+		out->open_tag = 0;
+	}
+}
+
+static int ijxml__is_whitespace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* keys compare bytewise, a prefix sorts first */
+static int ijxml__canonical_key_less(const char *xml, const struct ijxml__canonical_attribute *a, const struct ijxml__canonical_attribute *b)
+{
+	unsigned i, len = a->key_len < b->key_len ? a->key_len : b->key_len;
+
+	for (i=0; i != len; ++i) {
+		if (xml[a->key+i] != xml[b->key+i])
+			return (unsigned char)xml[a->key+i] < (unsigned char)xml[b->key+i];
+	}
+
+	return a->key_len < b->key_len;
+}
+
+static void ijxml__canonical_write_attribute(struct ijxml__canonical_output *out, const char *xml, const struct ijxml__canonical_attribute *attribute)
+{
+	unsigned pos = attribute->value, end = attribute->value + attribute->value_len, quote;
+
+	ijxml__canonical_emit(out, " ", 1);
+	ijxml__canonical_emit(out, xml + attribute->key, attribute->key_len);
+	ijxml__canonical_emit(out, "=\"", 2);
+
+	/* only values that were single quoted can contain a double quote */
+	while ((quote = ijxml__find_char(xml, pos, end, '"')) != end) {
+		ijxml__canonical_emit(out, xml + pos, quote - pos);
+		ijxml__canonical_emit(out, "&quot;", 6);
+		pos = quote + 1;
+	}
+
+	ijxml__canonical_emit(out, xml + pos, end - pos);
+	ijxml__canonical_emit(out, "\"", 1);
+}
+
+/* '*position' is at the '<' of a start tag, '>' is left pending so an element without content becomes '<name/>' */
+static int ijxml__canonical_start_tag(struct ijxml__canonical_output *out, const char *xml, unsigned xml_len, unsigned *position, unsigned flags)
+{
+	struct ijxml__canonical_attribute attributes[IJXML_CANONICAL_MAX_ATTRIBUTES], attribute;
+	unsigned i, pos = *position + 1, num_attributes = 0u;
+	char quote;
+
+	while (pos < xml_len && !ijxml__is_whitespace(xml[pos]) && xml[pos] != '/' && xml[pos] != '>')
+		++pos;
+
+	if (pos == *position + 1)
+		return IJXML_CANONICAL_MALFORMED;
+
+	ijxml__canonical_close_tag(out);
+	ijxml__canonical_emit(out, xml + *position, pos - *position);
+
+	for (;;) {
+		while (pos < xml_len && ijxml__is_whitespace(xml[pos]))
+			++pos;
+
+		if (pos == xml_len)
+			return IJXML_CANONICAL_MALFORMED;
+
+		if (xml[pos] == '>' || xml[pos] == '/')
+			break;
+
+		attribute.key = pos;
+		while (pos < xml_len && !ijxml__is_whitespace(xml[pos]) && xml[pos] != '=' && xml[pos] != '/' && xml[pos] != '>')
+			++pos;
+
+		attribute.key_len = pos - attribute.key;
+
+		while (pos < xml_len && ijxml__is_whitespace(xml[pos]))
+			++pos;
+
+		if (attribute.key_len == 0 || pos == xml_len || xml[pos] != '=')
+			return IJXML_CANONICAL_MALFORMED;
+
+		++pos;
+		while (pos < xml_len && ijxml__is_whitespace(xml[pos]))
+			++pos;
+
+		if (pos == xml_len || (xml[pos] != '"' && xml[pos] != '\''))
+			return IJXML_CANONICAL_MALFORMED;
+
+		quote = xml[pos++];
+		attribute.value = pos;
+		pos = ijxml__find_char(xml, pos, xml_len, quote);
+		if (pos == xml_len)
+			return IJXML_CANONICAL_MALFORMED;
+
+		attribute.value_len = pos++ - attribute.value;
+
+		if (!(flags & IJXML_CANONICAL_SORT_ATTRIBUTES)) {
+			ijxml__canonical_write_attribute(out, xml, &attribute);
+			continue;
+		}
+
+		if (num_attributes == IJXML_CANONICAL_MAX_ATTRIBUTES)
+			return IJXML_CANONICAL_TOO_MANY_ATTRIBUTES;
+
+		/* insertion sort, elements rarely have more than a handful of attributes */
+		for (i = num_attributes++; i && ijxml__canonical_key_less(xml, &attribute, &attributes[i-1]); --i)
+			attributes[i] = attributes[i-1];
+
+		attributes[i] = attribute;
+	}
+
+	for (i=0; i != num_attributes; ++i)
+		ijxml__canonical_write_attribute(out, xml, &attributes[i]);
+
+	if (xml[pos] == '/') {
+		if (pos+1 == xml_len || xml[pos+1] != '>')
+			return IJXML_CANONICAL_MALFORMED;
+
+		ijxml__canonical_emit(out, "/>", 2);
+		pos += 2;
+	} else {
+		out->open_tag = 1;
+		++pos;
+	}
+
+	*position = pos;
+
+	return IJXML_CANONICAL_SUCCESS;
+}
+
+int ijxml_canonicalize(const char *xml, unsigned xml_len, unsigned flags, ijxml_output_fn output, void *user, ijxml_hash_t *hash)
+{
+	struct ijxml__canonical_output out;
+	const char *end = xml + xml_len;
+	unsigned pos = 0u, run, name_end, text, depth = 0u;
+	int result = IJXML_CANONICAL_SUCCESS;
+
+	out.output = output;
+	out.user = user;
+	out.hash = hash;
+	out.failed = 0;
+	out.open_tag = 0;
+
+	if (hash)
+		*hash = IJXML_HASH_SEED;
+
+	if (ijxml__string_starts_with(xml, "\xEF\xBB\xBF", end))
+		pos = 3;
+
+	while (pos < xml_len && result == IJXML_CANONICAL_SUCCESS && !out.failed) {
+		if (xml[pos] != '<') {
+			/* text, dropped if it is only whitespace */
+			run = pos;
+			pos = ijxml__find_char(xml, pos, xml_len, '<');
+
+			for (text = run; text != pos && ijxml__is_whitespace(xml[text]); ++text)
+				;
+
+			if (text != pos) {
+				ijxml__canonical_close_tag(&out);
+				ijxml__canonical_emit(&out, xml + run, pos - run);
+			}
+
+			continue;
+		}
+
+		if (pos + 1 == xml_len)
+			return IJXML_CANONICAL_MALFORMED;
+
+		switch (xml[pos+1]) {
+			case '?' :
+				pos = ijxml__skip_past(xml, pos+2, xml_len, "?>");
+				break;
+
+			case '!' :
+				if (ijxml__string_starts_with(xml + pos, "<!--", end)) {
+					pos = ijxml__skip_past(xml, pos+4, xml_len, "-->");
+				} else if (ijxml__string_starts_with(xml + pos, "<![CDATA[", end)) {
+					run = pos + 9;
+					pos = ijxml__skip_past(xml, run, xml_len, "]]>");
+					if (pos != IJXML__TOKEN_INVALID_OFFSET) {
+						ijxml__canonical_close_tag(&out);
+						ijxml_escape(xml + run, pos - 3 - run, ijxml__canonical_emit, &out);
+					}
+				} else {
+					pos = ijxml__skip_declaration(xml, pos, xml_len);
+				}
+				break;
+
+			case '/' :
+				for (run = name_end = pos + 2; name_end < xml_len && xml[name_end] != '>' && !ijxml__is_whitespace(xml[name_end]); ++name_end)
+					;
+
+				pos = ijxml__skip_past(xml, name_end, xml_len, ">");
+				if (pos == IJXML__TOKEN_INVALID_OFFSET || name_end == run || depth == 0)
+					return IJXML_CANONICAL_MALFORMED;
+
+				--depth;
+				if (out.open_tag) {
+					ijxml__canonical_emit(&out, "/>", 2);
+					out.open_tag = 0;
+				} else {
+					ijxml__canonical_emit(&out, "</", 2);
+					ijxml__canonical_emit(&out, xml + run, name_end - run);
+					ijxml__canonical_emit(&out, ">", 1);
+				}
+				break;
+
+			default :
+				result = ijxml__canonical_start_tag(&out, xml, xml_len, &pos, flags);
+				if (out.open_tag)
+					++depth;
+		}
+
+		if (pos == IJXML__TOKEN_INVALID_OFFSET)
+			return IJXML_CANONICAL_MALFORMED;
+	}
+
+	if (result == IJXML_CANONICAL_SUCCESS && out.failed)
+		result = IJXML_CANONICAL_OUTPUT_FAILED;
+	else if (result == IJXML_CANONICAL_SUCCESS && depth != 0)
+		result = IJXML_CANONICAL_MALFORMED;
+
+	return result;
+}
+
+static struct ijxml_parse_result ijxml__parse_resume(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned max_bytes, unsigned max_tokens)
 {
 	struct ijxml_token *current_token;
 	unsigned num_parsed_tokens = parser->toknext;
 
+	/* a yielding parse stopped between two constructs and continues right there */
+	if (parser->yielded) {
+		parser->yielded = 0;
+		num_parsed_tokens = 0u;
+	}
+
 	while (num_parsed_tokens) {
 		current_token = &tokens[--num_parsed_tokens];
 		if (current_token->type == IJXML_OBJECT) {
@@ -413,6 +1341,9 @@ struct ijxml_parse_result ijxml_parse(struct ijxml_parser *parser, const char *x
 
 				if (current_token->parent != IJXML__NO_TOKEN_SUPER)
 					--tokens[current_token->parent].size;
+#if defined(IJXML_NAMESPACES)
+				ijxml__ns_pop(parser, num_parsed_tokens);
+#endif
 			} else {
 				parser->toksuper = parser->toksuper;
 			}
@@ -421,7 +1352,316 @@ struct ijxml_parse_result ijxml_parse(struct ijxml_parser *parser, const char *x
 		}
 	}
 
-	return ijxml__parse(parser, xml, xml_len, tokens, num_tokens);
+	if (parser->pos == 0u && xml_len >= 3u && (unsigned char)xml[0] == 0xEF && (unsigned char)xml[1] == 0xBB && (unsigned char)xml[2] == 0xBF)
+		parser->pos = 3u;
+
+	return ijxml__parse(parser, xml, xml_len, tokens, num_tokens, max_bytes, max_tokens);
+}
+
+struct ijxml_parse_result ijxml_parse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens)
+{
+	return ijxml__parse_resume(parser, xml, xml_len, tokens, num_tokens, (unsigned)-1, (unsigned)-1);
+}
+
+struct ijxml_parse_result ijxml_parse_budget(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned max_bytes, unsigned max_tokens)
+{
+	return ijxml__parse_resume(parser, xml, xml_len, tokens, num_tokens, max_bytes, max_tokens);
+}
+
+ijxml_encoding_t ijxml_detect_encoding(const char *data, unsigned len, unsigned *bom_len)
+{
+	const unsigned char *s = (const unsigned char *)data;
+
+	*bom_len = 0u;
+
+	if (len >= 3u && s[0] == 0xEF && s[1] == 0xBB && s[2] == 0xBF) {
+		*bom_len = 3u;
+		return IJXML_ENCODING_UTF8;
+	}
+
+	if (len >= 2u) {
+		if (s[0] == 0xFF && s[1] == 0xFE) {
+			*bom_len = 2u;
+			return IJXML_ENCODING_UTF16LE;
+		}
+
+		if (s[0] == 0xFE && s[1] == 0xFF) {
+			*bom_len = 2u;
+			return IJXML_ENCODING_UTF16BE;
+		}
+
+		if (s[0] == '<' && s[1] == 0)
+			return IJXML_ENCODING_UTF16LE;
+
+		if (s[0] == 0 && s[1] == '<')
+			return IJXML_ENCODING_UTF16BE;
+	}
+
+	return IJXML_ENCODING_UTF8;
+}
+
+unsigned ijxml_utf16_to_utf8(const char *data, unsigned len, ijxml_encoding_t encoding, char *buffer, unsigned buffer_size, int *error)
+{
+	const unsigned char *s = (const unsigned char *)data;
+	unsigned i, n, out = 0u, unit, low, codepoint;
+	unsigned char encoded[4];
+	int big_endian = (encoding == IJXML_ENCODING_UTF16BE);
+
+	*error = (len & 1u) ? 1 : 0;
+
+	for (i=0; i+1 < len; i += 2) {
+		unit = big_endian ? ((unsigned)s[i] << 8 | s[i+1]) : ((unsigned)s[i+1] << 8 | s[i]);
+		codepoint = unit;
+
+		if (unit >= 0xD800u && unit <= 0xDBFFu) {
+			if (i+3 >= len) {
+				*error = 1;
+				break;
+			}
+
+			low = big_endian ? ((unsigned)s[i+2] << 8 | s[i+3]) : ((unsigned)s[i+3] << 8 | s[i+2]);
+			if (low < 0xDC00u || low > 0xDFFFu) {
+				*error = 1;
+				break;
+			}
+
+			codepoint = 0x10000u + ((unit - 0xD800u) << 10) + (low - 0xDC00u);
+			i += 2;
+		} else if (unit >= 0xDC00u && unit <= 0xDFFFu) {
+			*error = 1;
+			break;
+		}
+
+		if (codepoint < 0x80u) {
+			encoded[0] = (unsigned char)codepoint;
+			n = 1;
+		} else if (codepoint < 0x800u) {
+			encoded[0] = (unsigned char)(0xC0u | (codepoint >> 6));
+			encoded[1] = (unsigned char)(0x80u | (codepoint & 0x3Fu));
+			n = 2;
+		} else if (codepoint < 0x10000u) {
+			encoded[0] = (unsigned char)(0xE0u | (codepoint >> 12));
+			encoded[1] = (unsigned char)(0x80u | ((codepoint >> 6) & 0x3Fu));
+			encoded[2] = (unsigned char)(0x80u | (codepoint & 0x3Fu));
+			n = 3;
+		} else {
+			encoded[0] = (unsigned char)(0xF0u | (codepoint >> 18));
+			encoded[1] = (unsigned char)(0x80u | ((codepoint >> 12) & 0x3Fu));
+			encoded[2] = (unsigned char)(0x80u | ((codepoint >> 6) & 0x3Fu));
+			encoded[3] = (unsigned char)(0x80u | (codepoint & 0x3Fu));
+			n = 4;
+		}
+
+		if (out + n <= buffer_size) {
+			unsigned j;
+			for (j=0; j != n; ++j)
+				buffer[out+j] = (char)encoded[j];
+		}
+
+		out += n;
+	}
+
+	return out;
+}
+
+/* index of the first token in [first, last) starting at or after 'pos', token starts are in ascending order */
+static unsigned ijxml__lower_bound(struct ijxml_token *tokens, unsigned first, unsigned last, unsigned pos)
+{
+	unsigned mid;
+
+	while (first < last) {
+		mid = first + (last - first) / 2;
+		if (tokens[mid].start < pos)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	return first;
+}
+
+#if defined(IJXML_NAMESPACES)
+/* moves the URIs starting at or after 'from' by 'delta' */
+static void ijxml__ns_shift_uris(struct ijxml_ns_context *ns, unsigned num_uris, unsigned from, unsigned delta)
+{
+	unsigned i;
+
+	for (i=0; i != num_uris; ++i) {
+		if (ns->uris[i].start >= from) {
+			ns->uris[i].start += delta;
+			ns->uris[i].end += delta;
+		}
+	}
+}
+#endif
+
+static void ijxml__reverse_tokens(struct ijxml_token *first, struct ijxml_token *last)
+{
+	struct ijxml_token tmp;
+
+	while (first != last && first != --last) {
+		tmp = *first;
+		*first++ = *last;
+		*last = tmp;
+	}
+}
+
+struct ijxml_parse_result ijxml_reparse(struct ijxml_parser *parser, const char *xml, unsigned xml_len, struct ijxml_token *tokens, unsigned num_tokens, unsigned edit_start, unsigned removed_len, unsigned inserted_len)
+{
+	struct ijxml_parse_result result;
+	struct ijxml_parser subparser;
+	struct ijxml_token *token, *scratch;
+	unsigned i, object_index, object_parent, subtree_end, num_old, num_new, num_tail;
+	unsigned edit_end = edit_start + removed_len;
+	unsigned delta = inserted_len - removed_len;	/* wraps for shrinking edits, offsets are shifted modulo 2^n */
+	unsigned index_delta;
+#if defined(IJXML_NAMESPACES)
+	unsigned num_outer_bindings = 0u, num_old_uris = 0u;
+#endif
+
+	result.error = 1;
+
+	/* only complete documents, the unused tail of 'tokens' is the scratch area */
+	if (parser->toknext == 0 || parser->toksuper != IJXML__NO_TOKEN_SUPER || parser->yielded || parser->toknext >= num_tokens)
+		return result;
+
+	i = ijxml__lower_bound(tokens, 0u, parser->toknext, edit_start);
+	if (i == 0)
+		return result;
+
+	/* smallest object containing the edit, its opening '<' must be left intact */
+	object_index = i - 1;
+	for (;;) {
+		token = &tokens[object_index];
+		if (token->type == IJXML_OBJECT && edit_start < token->end && edit_end <= token->end)
+			break;
+
+		object_index = token->parent;
+		if (object_index == IJXML__NO_TOKEN_SUPER)
+			return result;
+	}
+
+	if (token->end + delta > xml_len)
+		return result;
+
+	object_parent = token->parent;
+	subtree_end = ijxml__lower_bound(tokens, object_index+1, parser->toknext, token->end);
+	num_tail = parser->toknext - subtree_end;
+
+	num_old = subtree_end - object_index;
+
+	/* ijxml__ns_push_scope reads the declarations of the enclosing objects up to 'object_index' */
+	subparser.pos = token->start;
+	subparser.toknext = object_index;
+	subparser.toksuper = IJXML__NO_TOKEN_SUPER;
+	subparser.yielded = 0;
+
+	/* the new subtree is tokenized on its own behind the current tokens, its parent links are relative to 'scratch' */
+	scratch = tokens + parser->toknext;
+
+#if defined(IJXML_NAMESPACES)
+	subparser.ns = parser->ns;
+	if (parser->ns) {
+		struct ijxml_ns_context *ns = parser->ns;
+
+		/* interned URIs point into the document, refuse edits touching them */
+		for (i=0; i != ns->num_uris; ++i) {
+			if (edit_start <= ns->uris[i].end && ns->uris[i].start <= edit_end)
+				return result;
+		}
+
+		num_outer_bindings = ns->num_bindings;
+		num_old_uris = ns->num_uris;
+
+		/* interning compares against the edited document, so the URIs behind the edit move first.
+		 * none of them touches the edit, after the shift they are exactly the ones starting at or after 'edit_start' */
+		ijxml__ns_shift_uris(ns, num_old_uris, edit_end, delta);
+
+		result.error = 0;
+		ijxml__ns_push_scope(&subparser, xml, tokens, object_parent, &result);
+		if (result.error != 0) {
+			ns->num_bindings = num_outer_bindings;
+			ijxml__ns_shift_uris(ns, num_old_uris, edit_start, 0u - delta);
+			return result;
+		}
+
+		/* the enclosing bindings belong to the subtree root now, children popping their scope must not drop them */
+		for (i=num_outer_bindings; i != ns->num_bindings; ++i)
+			ns->bindings[i].object = 0u;
+	}
+#endif
+
+	subparser.toknext = 0u;
+
+	result = ijxml__parse(&subparser, xml, token->end + delta, scratch, num_tokens - parser->toknext, (unsigned)-1, (unsigned)-1);
+
+	if (result.error != 0 || subparser.toknext == 0 || subparser.toksuper != IJXML__NO_TOKEN_SUPER || scratch[0].type != IJXML_OBJECT || scratch[0].end != token->end + delta)
+		result.error = 1;
+
+#if defined(IJXML_NAMESPACES)
+	if (parser->ns) {
+		parser->ns->num_bindings = num_outer_bindings;
+		if (result.error != 0) {
+			parser->ns->num_uris = num_old_uris;
+			ijxml__ns_shift_uris(parser->ns, num_old_uris, edit_start, 0u - delta);
+		}
+	}
+#endif
+
+	if (result.error != 0)
+		return result;
+
+	num_new = subparser.toknext;
+	index_delta = num_new - num_old;
+
+	/* the new subtree takes the place of the old one, the tail only moves if the number of tokens changed */
+	for (i=0; i != num_new && i != num_old; ++i)
+		tokens[object_index + i] = scratch[i];
+
+	if (num_new < num_old) {
+		for (i=0; i != num_tail; ++i)
+			tokens[object_index + num_new + i] = tokens[subtree_end + i];
+	} else if (num_new > num_old) {
+		/* [tail][copied][rest of the new subtree] */
+		if (index_delta <= num_old) {
+			/* the tail moves up into the copied tokens only */
+			for (i=num_tail; i != 0; --i)
+				tokens[subtree_end + index_delta + i - 1] = tokens[subtree_end + i - 1];
+			for (i=0; i != index_delta; ++i)
+				tokens[subtree_end + i] = scratch[num_old + i];
+		} else {
+			/* [tail][rest of the new subtree] -> [rest of the new subtree][tail] */
+			for (i=0; i != index_delta; ++i)
+				scratch[i] = scratch[num_old + i];
+			ijxml__reverse_tokens(tokens + subtree_end, scratch);
+			ijxml__reverse_tokens(scratch, scratch + index_delta);
+			ijxml__reverse_tokens(tokens + subtree_end, scratch + index_delta);
+		}
+	}
+
+	tokens[object_index].parent = object_parent;
+	for (i=object_index+1; i != object_index+num_new; ++i)
+		tokens[i].parent += object_index;
+
+	for (i=object_index+num_new; i != object_index+num_new+num_tail; ++i) {
+		token = &tokens[i];
+		token->start += delta;
+		token->end += delta;
+#if defined(IJXML_NAMESPACES)
+		if (token->local != IJXML__TOKEN_INVALID_OFFSET)
+			token->local += delta;
+#endif
+		if (token->parent != IJXML__NO_TOKEN_SUPER && token->parent >= subtree_end)
+			token->parent += index_delta;
+	}
+
+	for (i=object_parent; i != IJXML__NO_TOKEN_SUPER; i=tokens[i].parent)
+		tokens[i].end += delta;
+
+	parser->toknext = object_index + num_new + num_tail;
+	parser->pos += delta;
+
+	return result;
 }
 
-#endif
\ No newline at end of file
+#endif
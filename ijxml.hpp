@@ -0,0 +1,266 @@
+#ifndef _IJXML_HPP_
+#define _IJXML_HPP_
+
+/* Optional C++17 layer over ijxml_aux. Nodes and ranges are views into the token array, nothing is allocated.
+ * The aux implementation (IJXML_AUX_IMPLEMENTATION) still has to be compiled in one C or C++ file. */
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+
+extern "C" {
+#include "ijxml_aux.h"
+}
+
+namespace ijxml {
+
+/* ijxml_hash usable at compile time to switch over tag names: switch (node.tag_hash()) { case ijxml::hash("item"): ... } */
+constexpr ijxml_hash_t hash(std::string_view s)
+{
+	ijxml_hash_t h = IJXML_HASH_SEED;
+	for (char c : s)
+		h = (h ^ static_cast<unsigned char>(c)) * IJXML_HASH_PRIME;
+
+	return h;
+}
+
+/* a tag or attribute name, its length is computed at compile time when built from a literal and compared before any byte */
+struct name {
+	std::string_view text;
+
+	constexpr name(std::string_view s) : text(s) {}
+	constexpr name(const char *s) : text(s) {}
+};
+
+namespace detail {
+
+inline std::string_view span(const ijxml_aux_context *context, const ijxml_token &token)
+{
+	return std::string_view(context->xml + token.start, token.end - token.start);
+}
+
+/* lengths are compared before any byte is touched */
+inline bool equals(const ijxml_aux_context *context, const ijxml_token &token, const name &n)
+{
+	std::size_t len = token.end - token.start;
+	if (len != n.text.size())
+		return false;
+
+	return len == 0 || (context->xml[token.start] == n.text[0] && std::string_view(context->xml + token.start, len) == n.text);
+}
+
+/* first token in [first, last) starting at or after 'pos', token starts are in ascending order */
+inline unsigned lower_bound(const ijxml_token *tokens, unsigned first, unsigned last, unsigned pos)
+{
+	while (first < last) {
+		unsigned mid = first + (last - first) / 2;
+		if (tokens[mid].start < pos)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	return first;
+}
+
+/* first OBJECT child of 'parent' at or after token 'from', skips whole subtrees in between */
+inline unsigned next_object(const ijxml_aux_context *context, unsigned parent, unsigned from)
+{
+	const ijxml_token *tokens = context->tokens;
+
+	while (from < context->num_tokens && tokens[from].parent == parent) {
+		if (tokens[from].type == IJXML_OBJECT)
+			return from;
+
+		++from;
+	}
+
+	return IJXML_AUX_INVALID_TOKEN_OFFSET;
+}
+
+}
+
+class attribute {
+public:
+	attribute() = default;
+	attribute(const ijxml_aux_context *context, unsigned key_index) : context_(context), key_(key_index) {}
+
+	explicit operator bool() const { return key_ != IJXML_AUX_INVALID_TOKEN_OFFSET; }
+
+	std::string_view key() const { return detail::span(context_, context_->tokens[key_]); }
+	std::string_view value() const { return detail::span(context_, context_->tokens[key_+1]); }
+	unsigned key_index() const { return key_; }
+	unsigned value_index() const { return key_+1; }
+
+private:
+	const ijxml_aux_context *context_ = nullptr;
+	unsigned key_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+};
+
+class attribute_iterator {
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = attribute;
+	using difference_type = std::ptrdiff_t;
+	using pointer = const attribute *;
+	using reference = attribute;
+
+	attribute_iterator() = default;
+	attribute_iterator(const ijxml_aux_context *context, unsigned object, unsigned key) : context_(context), object_(object), key_(key) { settle(); }
+
+	attribute operator*() const { return attribute(context_, key_); }
+	attribute_iterator &operator++() { key_ += 2; settle(); return *this; }
+	attribute_iterator operator++(int) { attribute_iterator it = *this; ++*this; return it; }
+
+	bool operator==(const attribute_iterator &other) const { return key_ == other.key_; }
+	bool operator!=(const attribute_iterator &other) const { return key_ != other.key_; }
+
+private:
+	void settle()
+	{
+		if (key_ >= context_->num_tokens || key_ + 1 >= context_->num_tokens || context_->tokens[key_].type != IJXML_ATTRIBUTE_KEY || context_->tokens[key_].parent != object_)
+			key_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+	}
+
+	const ijxml_aux_context *context_ = nullptr;
+	unsigned object_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+	unsigned key_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+};
+
+class child_iterator;
+
+template <typename Iterator>
+class range {
+public:
+	range(Iterator first, Iterator last) : first_(first), last_(last) {}
+
+	Iterator begin() const { return first_; }
+	Iterator end() const { return last_; }
+	bool empty() const { return first_ == last_; }
+
+private:
+	Iterator first_, last_;
+};
+
+class node {
+public:
+	node() = default;
+	node(const ijxml_aux_context *context, unsigned object_index) : context_(context), index_(object_index)
+	{
+		if (index_ >= context_->num_tokens || context_->tokens[index_].type != IJXML_OBJECT)
+			index_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+	}
+
+	explicit operator bool() const { return index_ != IJXML_AUX_INVALID_TOKEN_OFFSET; }
+	bool operator==(const node &other) const { return index_ == other.index_; }
+	bool operator!=(const node &other) const { return index_ != other.index_; }
+
+	unsigned index() const { return index_; }
+	const ijxml_token &token() const { return context_->tokens[index_]; }
+
+	/* the whole element, markup included */
+	std::string_view xml() const { return detail::span(context_, token()); }
+	std::string_view tag() const { return detail::span(context_, context_->tokens[index_+1]); }
+	ijxml_hash_t tag_hash() const { return hash(tag()); }
+	bool is(const name &tag_name) const { return detail::equals(context_, context_->tokens[index_+1], tag_name); }
+
+	/* from the first to the last text token directly inside the element */
+	std::string_view text() const
+	{
+		const ijxml_token *tokens = context_->tokens;
+		unsigned i, first = IJXML_AUX_INVALID_TOKEN_OFFSET, last = 0;
+
+		for (i = index_+1; i < context_->num_tokens && tokens[i].start < token().end; ++i) {
+			if (tokens[i].parent != index_ || (tokens[i].type != IJXML_VALUE && tokens[i].type != IJXML_STRING))
+				continue;
+
+			if (first == IJXML_AUX_INVALID_TOKEN_OFFSET)
+				first = tokens[i].start;
+			last = tokens[i].end;
+		}
+
+		if (first == IJXML_AUX_INVALID_TOKEN_OFFSET)
+			return std::string_view();
+
+		return std::string_view(context_->xml + first, last - first);
+	}
+
+	range<attribute_iterator> attributes() const
+	{
+		return range<attribute_iterator>(attribute_iterator(context_, index_, index_+2), attribute_iterator(context_, index_, IJXML_AUX_INVALID_TOKEN_OFFSET));
+	}
+
+	attribute find_attribute(const name &key) const
+	{
+		for (attribute_iterator it = attributes().begin(), end = attributes().end(); it != end; ++it) {
+			attribute a = *it;
+			if (detail::equals(context_, context_->tokens[a.key_index()], key))
+				return a;
+		}
+
+		return attribute();
+	}
+
+	range<child_iterator> children() const;
+	node child(const name &tag_name) const;
+
+private:
+	const ijxml_aux_context *context_ = nullptr;
+	unsigned index_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+};
+
+/* steps from a child to its next sibling by binary searching past the child's extent, so iterating all
+ * children of an element is not quadratic like looping over ijxml_aux_object_at */
+class child_iterator {
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = node;
+	using difference_type = std::ptrdiff_t;
+	using pointer = const node *;
+	using reference = node;
+
+	child_iterator() = default;
+	child_iterator(const ijxml_aux_context *context, unsigned parent, unsigned child) : context_(context), parent_(parent), child_(child) {}
+
+	node operator*() const { return node(context_, child_); }
+	child_iterator &operator++()
+	{
+		unsigned next = detail::lower_bound(context_->tokens, child_+1, context_->num_tokens, context_->tokens[child_].end);
+		child_ = detail::next_object(context_, parent_, next);
+		return *this;
+	}
+	child_iterator operator++(int) { child_iterator it = *this; ++*this; return it; }
+
+	bool operator==(const child_iterator &other) const { return child_ == other.child_; }
+	bool operator!=(const child_iterator &other) const { return child_ != other.child_; }
+
+private:
+	const ijxml_aux_context *context_ = nullptr;
+	unsigned parent_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+	unsigned child_ = IJXML_AUX_INVALID_TOKEN_OFFSET;
+};
+
+inline range<child_iterator> node::children() const
+{
+	return range<child_iterator>(child_iterator(context_, index_, detail::next_object(context_, index_, index_+1)), child_iterator(context_, index_, IJXML_AUX_INVALID_TOKEN_OFFSET));
+}
+
+inline node node::child(const name &tag_name) const
+{
+	for (node n : children()) {
+		if (n.is(tag_name))
+			return n;
+	}
+
+	return node();
+}
+
+/* the root element of a parsed document */
+inline node root(const ijxml_aux_context &context)
+{
+	return node(&context, 0);
+}
+
+}
+
+#endif
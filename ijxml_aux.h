@@ -6,12 +6,80 @@
 typedef enum {
 	IJXML_AUX_BUFFER_TRUNCATED = -1,
 	IJXML_AUX_INVALID_TOKEN_INDEX = -2,
+	IJXML_AUX_INDEX_MISMATCH = -3,
+	IJXML_AUX_CONVERSION_FAILED = -4,
+	IJXML_AUX_INVALID_COLUMN = -5,
 
 	IJXML_AUX_SUCCESS = 0,
 } ijxml_aux_err_t;
 
 #define IJXML_AUX_INVALID_TOKEN_OFFSET		((unsigned)-1)
 
+/* layout of a serialized token index: the header, 'num_tokens' tokens, then 'num_uris' namespace URI spans.
+ * everything is 'unsigned' sized so a mapped index only has to be aligned as an unsigned. */
+#define IJXML_AUX_INDEX_MAGIC		0x4958494au	/* 'IJXI' read in native byte order */
+#define IJXML_AUX_INDEX_VERSION		1u
+
+typedef struct ijxml_aux_index_header {
+	unsigned magic;
+	unsigned version;
+	unsigned token_size;
+	unsigned num_tokens;
+	unsigned num_uris;
+	unsigned xml_len;
+	unsigned xml_hash;
+} ijxml_aux_index_header;
+
+struct ijxml_ns_context;
+
+/* 64 bit integer type used for typed conversions, define before including to override (must be a signed builtin type) */
+#if !defined(IJXML_AUX_INT64)
+	#define IJXML_AUX_INT64 long long
+#endif
+
+typedef struct ijxml_aux_span {
+	unsigned start;
+	unsigned end;
+} ijxml_aux_span;
+
+typedef enum {
+	IJXML_AUX_BIND_SPAN,		/* struct ijxml_aux_span into the document */
+	IJXML_AUX_BIND_STRING,		/* char[size], NULL terminated */
+	IJXML_AUX_BIND_INT,			/* int */
+	IJXML_AUX_BIND_INT64,		/* IJXML_AUX_INT64 */
+	IJXML_AUX_BIND_DOUBLE,		/* double */
+	IJXML_AUX_BIND_STRUCT		/* nested struct described by 'fields' */
+} ijxml_aux_bind_type_t;
+
+typedef enum {
+	IJXML_AUX_BIND_ATTRIBUTE,
+	IJXML_AUX_BIND_ELEMENT		/* child element, scalars take the element's text */
+} ijxml_aux_bind_source_t;
+
+/* maps an attribute or child element by name onto a field of a C struct, typically a static table built with offsetof */
+typedef struct ijxml_aux_binding {
+	const char *name;
+	ijxml_aux_bind_source_t source;
+	ijxml_aux_bind_type_t type;
+	unsigned offset;
+	unsigned size;			/* STRING buffer size, distance between elements of repeated fields */
+
+	const struct ijxml_aux_binding *fields;	/* STRUCT */
+	unsigned num_fields;
+
+	unsigned max_count;		/* > 0 makes a repeated element, filling an array at 'offset' */
+	unsigned count_offset;	/* unsigned receiving the number of repeated elements */
+} ijxml_aux_binding;
+
+/* one column of ijxml_aux_columns, 'values' and 'valid' hold one entry per row */
+typedef struct ijxml_aux_column {
+	const char *name;
+	ijxml_aux_bind_source_t source;
+	ijxml_aux_bind_type_t type;		/* SPAN, INT64 or DOUBLE */
+	void *values;					/* struct ijxml_aux_span, IJXML_AUX_INT64 or double array, missing values are zeroed */
+	unsigned char *valid;			/* bitmap, bit (row & 7) of byte (row >> 3) is set if the row has a value */
+} ijxml_aux_column;
+
 typedef struct ijxml_aux_context {
 	const char *xml;
 	struct ijxml_token *tokens;
@@ -36,6 +104,47 @@ unsigned ijxml_aux_tag(struct ijxml_aux_context *context, unsigned object_index)
 struct ijxml_token *ijxml_aux_token(struct ijxml_aux_context *context, unsigned token_index);
 unsigned ijxml_aux_token_index(struct ijxml_aux_context *context, struct ijxml_token *token);
 
+/* ijxml_hash over the document, its low 32 bits are stored in and checked against serialized indices */
+ijxml_hash_t ijxml_aux_hash(const char *xml, unsigned xml_len);
+
+/* Returns the number of bytes needed to serialize 'num_tokens' tokens (and 'num_uris' namespace URIs), 0 if that does not fit an unsigned */
+unsigned ijxml_aux_index_size(unsigned num_tokens, unsigned num_uris);
+
+/* Serializes the tokens (and the interned namespace URIs if 'ns' is not NULL) into 'index'.
+ * Returns the number of bytes written, 0 if 'index_size' is too small. */
+unsigned ijxml_aux_index_write(void *index, unsigned index_size, const char *xml, unsigned xml_len, const struct ijxml_token *tokens, unsigned num_tokens, const struct ijxml_ns_context *ns);
+
+/* Initializes 'context' to use the tokens stored in 'index' directly, e.g. a mapped file, which has to outlive the context.
+ * 'ns' (optional) is pointed at the stored namespace URIs. Hashing the document is skipped unless 'verify_hash' is set. */
+int ijxml_aux_index_init(struct ijxml_aux_context *context, void *index, unsigned index_size, const char *xml, unsigned xml_len, int verify_hash, struct ijxml_ns_context *ns);
+
+/* Fills 'target' from the attributes and child elements of 'object_index' in a single pass over its tokens.
+ * Fields not present in the document are left untouched. Returns IJXML_AUX_CONVERSION_FAILED if a number did not
+ * convert, IJXML_AUX_BUFFER_TRUNCATED if a string or repeated field was cut short, all other fields are filled anyway. */
+int ijxml_aux_bind(struct ijxml_aux_context *context, unsigned object_index, const struct ijxml_aux_binding *fields, unsigned num_fields, void *target);
+
+/* Exports the child elements of 'parent_index' named 'row_tag' (all child elements if NULL) as rows, filling every column
+ * with one value per row in a single pass over the tokens. Stores the number of rows in 'num_rows'. Returns
+ * IJXML_AUX_BUFFER_TRUNCATED if there were more than 'max_rows' rows, IJXML_AUX_CONVERSION_FAILED if a number did
+ * not convert (the value is left invalid), all other values are exported anyway. Columns of any other type than
+ * SPAN, INT64 or DOUBLE are refused with IJXML_AUX_INVALID_COLUMN before anything is written. */
+int ijxml_aux_columns(struct ijxml_aux_context *context, unsigned parent_index, const char *row_tag, const struct ijxml_aux_column *columns, unsigned num_columns, unsigned max_rows, unsigned *num_rows);
+
+/* conversions used by the binding, 'start' and 'end' delimit the text. Doubles are not correctly rounded in all cases. */
+int ijxml_aux_parse_int64(const char *start, const char *end, IJXML_AUX_INT64 *value);
+int ijxml_aux_parse_double(const char *start, const char *end, double *value);
+
+#if defined(IJXML_NAMESPACES)
+/* Returns the namespace id of 'uri' (IJXML_NS_UNKNOWN if the document never declares it).
+ * Look it up once, the *_ns queries below then compare ids instead of prefixes. */
+unsigned ijxml_aux_namespace(struct ijxml_aux_context *context, const struct ijxml_ns_context *ns, const char *uri);
+
+unsigned ijxml_aux_object_by_tag_ns(struct ijxml_aux_context *context, unsigned parent_object_index, unsigned ns, const char *local_name);
+
+/* Returns the VALUE token index */
+unsigned ijxml_aux_object_attribute_ns(struct ijxml_aux_context *context, unsigned object_index, unsigned ns, const char *local_name);
+#endif
+
 #endif
 
 #if defined(IJXML_AUX_IMPLEMENTATION)
@@ -130,6 +239,103 @@ static void ijxml_aux__buffer_copy(char *dest, const char *source, unsigned len)
 		*dest++ = *source++;
 }
 
+ijxml_hash_t ijxml_aux_hash(const char *xml, unsigned xml_len)
+{
+	return ijxml_hash(IJXML_HASH_SEED, xml, xml_len);
+}
+
+/* divides instead of multiplying, counts read from an index file must not overflow the size check */
+static int ijxml_aux__index_fits(unsigned index_size, unsigned num_tokens, unsigned num_uris)
+{
+	unsigned remaining;
+
+	if (index_size < sizeof(struct ijxml_aux_index_header))
+		return 0;
+
+	remaining = index_size - (unsigned)sizeof(struct ijxml_aux_index_header);
+	if (num_tokens > remaining / sizeof(struct ijxml_token))
+		return 0;
+
+	remaining -= num_tokens*(unsigned)sizeof(struct ijxml_token);
+
+	return num_uris <= remaining / (2u*sizeof(unsigned));
+}
+
+unsigned ijxml_aux_index_size(unsigned num_tokens, unsigned num_uris)
+{
+	if (!ijxml_aux__index_fits((unsigned)-1, num_tokens, num_uris))
+		return 0;
+
+	return (unsigned)(sizeof(struct ijxml_aux_index_header) + num_tokens*sizeof(struct ijxml_token) + num_uris*2u*sizeof(unsigned));
+}
+
+unsigned ijxml_aux_index_write(void *index, unsigned index_size, const char *xml, unsigned xml_len, const struct ijxml_token *tokens, unsigned num_tokens, const struct ijxml_ns_context *ns)
+{
+	struct ijxml_aux_index_header *header = (struct ijxml_aux_index_header *)index;
+	unsigned num_uris = 0u, size;
+
+#if defined(IJXML_NAMESPACES)
+	if (ns)
+		num_uris = ns->num_uris;
+#else
+	(void)ns;
+#endif
+
+	if (!ijxml_aux__index_fits(index_size, num_tokens, num_uris))
+		return 0;
+
+	size = ijxml_aux_index_size(num_tokens, num_uris);
+
+	header->magic = IJXML_AUX_INDEX_MAGIC;
+	header->version = IJXML_AUX_INDEX_VERSION;
+	header->token_size = (unsigned)sizeof(struct ijxml_token);
+	header->num_tokens = num_tokens;
+	header->num_uris = num_uris;
+	header->xml_len = xml_len;
+	header->xml_hash = (unsigned)ijxml_aux_hash(xml, xml_len);
+
+	ijxml_aux__buffer_copy((char *)(header+1), (const char *)tokens, num_tokens*(unsigned)sizeof(struct ijxml_token));
+
+#if defined(IJXML_NAMESPACES)
+	if (num_uris)
+		ijxml_aux__buffer_copy((char *)((struct ijxml_token *)(header+1) + num_tokens), (const char *)ns->uris, num_uris*(unsigned)sizeof(struct ijxml_ns_uri));
+#endif
+
+	return size;
+}
+
+int ijxml_aux_index_init(struct ijxml_aux_context *context, void *index, unsigned index_size, const char *xml, unsigned xml_len, int verify_hash, struct ijxml_ns_context *ns)
+{
+	struct ijxml_aux_index_header *header = (struct ijxml_aux_index_header *)index;
+
+	if (index_size < sizeof(struct ijxml_aux_index_header))
+		return IJXML_AUX_INDEX_MISMATCH;
+
+	if (header->magic != IJXML_AUX_INDEX_MAGIC || header->version != IJXML_AUX_INDEX_VERSION || header->token_size != sizeof(struct ijxml_token))
+		return IJXML_AUX_INDEX_MISMATCH;
+
+	if (!ijxml_aux__index_fits(index_size, header->num_tokens, header->num_uris) || header->xml_len != xml_len)
+		return IJXML_AUX_INDEX_MISMATCH;
+
+	if (verify_hash && header->xml_hash != (unsigned)ijxml_aux_hash(xml, xml_len))
+		return IJXML_AUX_INDEX_MISMATCH;
+
+	ijxml_aux_init(context, xml, (struct ijxml_token *)(header+1), header->num_tokens);
+
+#if defined(IJXML_NAMESPACES)
+	if (ns) {
+		ns->bindings = 0;
+		ns->num_bindings = ns->max_bindings = 0u;
+		ns->uris = (struct ijxml_ns_uri *)(context->tokens + header->num_tokens);
+		ns->num_uris = ns->max_uris = header->num_uris;
+	}
+#else
+	(void)ns;
+#endif
+
+	return IJXML_AUX_SUCCESS;
+}
+
 unsigned ijxml_aux_token_copy(struct ijxml_aux_context *context, unsigned token_index, char *buffer, unsigned buffer_size, int *err)
 {
 	unsigned copy_len;
@@ -284,4 +490,528 @@ unsigned ijxml_aux_object_at(struct ijxml_aux_context *context, unsigned object_
 	return IJXML_AUX_INVALID_TOKEN_OFFSET;
 }
 
-#endif
\ No newline at end of file
+int ijxml_aux_parse_int64(const char *start, const char *end, IJXML_AUX_INT64 *value)
+{
+	unsigned IJXML_AUX_INT64 result = 0u, limit = ((unsigned IJXML_AUX_INT64)-1) >> 1;
+	int negative = 0;
+	unsigned digit;
+
+	if (start != end && (*start == '-' || *start == '+'))
+		negative = (*start++ == '-');
+
+	if (start == end)
+		return 0;
+
+	/* one more for the negative range */
+	if (negative)
+		++limit;
+
+	for (; start != end; ++start) {
+		if (*start < '0' || *start > '9')
+			return 0;
+
+		digit = (unsigned)(*start - '0');
+		if (result > (limit - digit) / 10u)
+			return 0;
+
+		result = result * 10u + digit;
+	}
+
+	*value = negative ? (IJXML_AUX_INT64)(0u - result) : (IJXML_AUX_INT64)result;
+
+	return 1;
+}
+
+int ijxml_aux_parse_double(const char *start, const char *end, double *value)
+{
+	double result = 0.0, scale = 1.0, base = 10.0;
+	int negative = 0, negative_exponent = 0, num_digits = 0;
+	int exponent = 0, decimals = 0, e = 0;
+
+	if (start != end && (*start == '-' || *start == '+'))
+		negative = (*start++ == '-');
+
+	for (; start != end && *start >= '0' && *start <= '9'; ++start, ++num_digits)
+		result = result * 10.0 + (*start - '0');
+
+	if (start != end && *start == '.') {
+		for (++start; start != end && *start >= '0' && *start <= '9'; ++start, ++num_digits, ++decimals)
+			result = result * 10.0 + (*start - '0');
+	}
+
+	if (num_digits == 0)
+		return 0;
+
+	if (start != end && (*start == 'e' || *start == 'E')) {
+		++start;
+		if (start != end && (*start == '-' || *start == '+'))
+			negative_exponent = (*start++ == '-');
+
+		if (start == end)
+			return 0;
+
+		for (; start != end && *start >= '0' && *start <= '9'; ++start) {
+			if (e < 10000)
+				e = e * 10 + (*start - '0');
+		}
+	}
+
+	if (start != end)
+		return 0;
+
+	exponent = (negative_exponent ? -e : e) - decimals;
+	e = exponent < 0 ? -exponent : exponent;
+
+	/* 10^|exponent| by squaring */
+	for (; e; e >>= 1, base *= base) {
+		if (e & 1)
+			scale *= base;
+	}
+
+	result = exponent < 0 ? result / scale : result * scale;
+	*value = negative ? -result : result;
+
+	return 1;
+}
+
+/* index of the first token past the subtree of 'token_index' */
+static unsigned ijxml_aux__subtree_end(struct ijxml_aux_context *context, unsigned token_index)
+{
+	unsigned end = context->tokens[token_index].end, i = token_index+1;
+
+	while (i < context->num_tokens && context->tokens[i].start < end)
+		++i;
+
+	return i;
+}
+
+/* the element's text runs from its first to its last text token, empty elements give an empty text.
+ * returns the index of the first token past the element */
+static unsigned ijxml_aux__element_text(struct ijxml_aux_context *context, unsigned element, unsigned *text_start, unsigned *text_end)
+{
+	struct ijxml_token *tokens = context->tokens;
+	unsigned i, next = ijxml_aux__subtree_end(context, element);
+
+	*text_start = *text_end = tokens[element].end;
+
+	for (i=element+1; i != next; ++i) {
+		if (tokens[i].parent != element || (tokens[i].type != IJXML_VALUE && tokens[i].type != IJXML_STRING))
+			continue;
+
+		if (*text_start == tokens[element].end)
+			*text_start = tokens[i].start;
+
+		*text_end = tokens[i].end;
+	}
+
+	return next;
+}
+
+static void ijxml_aux__bind_value(struct ijxml_aux_context *context, const struct ijxml_aux_binding *field, unsigned start, unsigned end, char *dest, int *err)
+{
+	const char *xml = context->xml;
+	IJXML_AUX_INT64 i64;
+
+	switch (field->type) {
+		case IJXML_AUX_BIND_SPAN : {
+			struct ijxml_aux_span *span = (struct ijxml_aux_span *)dest;
+			span->start = start;
+			span->end = end;
+		} break;
+
+		case IJXML_AUX_BIND_STRING : {
+			unsigned len = end - start;
+
+			if (field->size == 0)
+				break;
+
+			if (len >= field->size) {
+				len = field->size - 1;
+				*err = IJXML_AUX_BUFFER_TRUNCATED;
+			}
+
+			ijxml_aux__buffer_copy(dest, xml + start, len);
+			dest[len] = '\0';
+		} break;
+
+		case IJXML_AUX_BIND_INT :
+			if (!ijxml_aux_parse_int64(xml + start, xml + end, &i64) || (IJXML_AUX_INT64)(int)i64 != i64)
+				*err = IJXML_AUX_CONVERSION_FAILED;
+			else
+				*(int *)dest = (int)i64;
+			break;
+
+		case IJXML_AUX_BIND_INT64 :
+			if (!ijxml_aux_parse_int64(xml + start, xml + end, &i64))
+				*err = IJXML_AUX_CONVERSION_FAILED;
+			else
+				*(IJXML_AUX_INT64 *)dest = i64;
+			break;
+
+		case IJXML_AUX_BIND_DOUBLE :
+			if (!ijxml_aux_parse_double(xml + start, xml + end, (double *)dest))
+				*err = IJXML_AUX_CONVERSION_FAILED;
+			break;
+
+		default:
+			break;
+	}
+}
+
+static const struct ijxml_aux_binding *ijxml_aux__find_binding(struct ijxml_aux_context *context, const struct ijxml_aux_binding *fields, unsigned num_fields, ijxml_aux_bind_source_t source, struct ijxml_token *name)
+{
+	unsigned i;
+
+	for (i=0; i != num_fields; ++i) {
+		if (fields[i].source == source && ijxml_aux__token_equals(name, context->xml, fields[i].name))
+			return &fields[i];
+	}
+
+	return 0;
+}
+
+/* returns the index of the first token past the object */
+static unsigned ijxml_aux__bind_object(struct ijxml_aux_context *context, unsigned object_index, const struct ijxml_aux_binding *fields, unsigned num_fields, char *target, int *err)
+{
+	struct ijxml_token *tokens = context->tokens, *token;
+	const struct ijxml_aux_binding *field;
+	unsigned i, end = tokens[object_index].end;
+	unsigned *count;
+	char *dest;
+
+	for (i=0; i != num_fields; ++i) {
+		if (fields[i].max_count)
+			*(unsigned *)(target + fields[i].count_offset) = 0u;
+	}
+
+	i = object_index+1;
+	while (i < context->num_tokens && tokens[i].start < end) {
+		token = &tokens[i];
+
+		if (token->type == IJXML_ATTRIBUTE_KEY && i+1 < context->num_tokens) {
+			field = ijxml_aux__find_binding(context, fields, num_fields, IJXML_AUX_BIND_ATTRIBUTE, token);
+			if (field)
+				ijxml_aux__bind_value(context, field, token[1].start, token[1].end, target + field->offset, err);
+
+			i += 2;
+			continue;
+		}
+
+		if (token->type != IJXML_OBJECT || i+1 >= context->num_tokens) {
+			++i;
+			continue;
+		}
+
+		field = ijxml_aux__find_binding(context, fields, num_fields, IJXML_AUX_BIND_ELEMENT, token+1);
+		if (!field) {
+			i = ijxml_aux__subtree_end(context, i);
+			continue;
+		}
+
+		dest = target + field->offset;
+		if (field->max_count) {
+			count = (unsigned *)(target + field->count_offset);
+			if (*count == field->max_count) {
+				*err = IJXML_AUX_BUFFER_TRUNCATED;
+				i = ijxml_aux__subtree_end(context, i);
+				continue;
+			}
+
+			dest += (*count)++ * field->size;
+		}
+
+		if (field->type == IJXML_AUX_BIND_STRUCT) {
+			i = ijxml_aux__bind_object(context, i, field->fields, field->num_fields, dest, err);
+		} else {
+			unsigned text_start, text_end;
+
+			i = ijxml_aux__element_text(context, i, &text_start, &text_end);
+			ijxml_aux__bind_value(context, field, text_start, text_end, dest, err);
+		}
+	}
+
+	return i;
+}
+
+int ijxml_aux_bind(struct ijxml_aux_context *context, unsigned object_index, const struct ijxml_aux_binding *fields, unsigned num_fields, void *target)
+{
+	int err = IJXML_AUX_SUCCESS;
+
+	if (object_index >= context->num_tokens || context->tokens[object_index].type != IJXML_OBJECT)
+		return IJXML_AUX_INVALID_TOKEN_INDEX;
+
+	ijxml_aux__bind_object(context, object_index, fields, num_fields, (char *)target, &err);
+
+	return err;
+}
+
+static const struct ijxml_aux_column *ijxml_aux__find_column(struct ijxml_aux_context *context, const struct ijxml_aux_column *columns, unsigned num_columns, ijxml_aux_bind_source_t source, struct ijxml_token *name)
+{
+	unsigned i;
+
+	for (i=0; i != num_columns; ++i) {
+		if (columns[i].source == source && ijxml_aux__token_equals(name, context->xml, columns[i].name))
+			return &columns[i];
+	}
+
+	return 0;
+}
+
+/* zeroes the value and clears the valid bit of 'row' */
+static void ijxml_aux__column_clear(const struct ijxml_aux_column *column, unsigned row)
+{
+	column->valid[row >> 3] &= (unsigned char)~(1u << (row & 7u));
+
+	switch (column->type) {
+		case IJXML_AUX_BIND_SPAN : {
+			struct ijxml_aux_span *span = (struct ijxml_aux_span *)column->values + row;
+			span->start = span->end = 0u;
+		} break;
+
+		case IJXML_AUX_BIND_INT64 :
+			((IJXML_AUX_INT64 *)column->values)[row] = 0;
+			break;
+
+		case IJXML_AUX_BIND_DOUBLE :
+			((double *)column->values)[row] = 0.0;
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void ijxml_aux__column_value(struct ijxml_aux_context *context, const struct ijxml_aux_column *column, unsigned row, unsigned start, unsigned end, int *err)
+{
+	unsigned char bit = (unsigned char)(1u << (row & 7u));
+	int converted = 0;
+
+	/* the first value found in a row wins */
+	if (column->valid[row >> 3] & bit)
+		return;
+
+	switch (column->type) {
+		case IJXML_AUX_BIND_SPAN : {
+			struct ijxml_aux_span *span = (struct ijxml_aux_span *)column->values + row;
+			span->start = start;
+			span->end = end;
+			converted = 1;
+		} break;
+
+		case IJXML_AUX_BIND_INT64 :
+			converted = ijxml_aux_parse_int64(context->xml + start, context->xml + end, (IJXML_AUX_INT64 *)column->values + row);
+			break;
+
+		case IJXML_AUX_BIND_DOUBLE :
+			converted = ijxml_aux_parse_double(context->xml + start, context->xml + end, (double *)column->values + row);
+			break;
+
+		default:
+			return;
+	}
+
+	if (converted)
+		column->valid[row >> 3] |= bit;
+	else
+		*err = IJXML_AUX_CONVERSION_FAILED;
+}
+
+int ijxml_aux_columns(struct ijxml_aux_context *context, unsigned parent_index, const char *row_tag, const struct ijxml_aux_column *columns, unsigned num_columns, unsigned max_rows, unsigned *num_rows)
+{
+	struct ijxml_token *tokens = context->tokens;
+	const struct ijxml_aux_column *column;
+	unsigned i, j, row_end, end, rows = 0u;
+	int err = IJXML_AUX_SUCCESS;
+
+	*num_rows = 0u;
+
+	if (parent_index >= context->num_tokens || tokens[parent_index].type != IJXML_OBJECT)
+		return IJXML_AUX_INVALID_TOKEN_INDEX;
+
+	for (j=0; j != num_columns; ++j) {
+		if (columns[j].type != IJXML_AUX_BIND_SPAN && columns[j].type != IJXML_AUX_BIND_INT64 && columns[j].type != IJXML_AUX_BIND_DOUBLE)
+			return IJXML_AUX_INVALID_COLUMN;
+	}
+
+	end = tokens[parent_index].end;
+	i = parent_index+1;
+	while (i < context->num_tokens && tokens[i].start < end) {
+		/* the parent's own tag, attributes and text */
+		if (tokens[i].type != IJXML_OBJECT || i+1 >= context->num_tokens) {
+			++i;
+			continue;
+		}
+
+		/* rows are consumed whole, so every object seen here is a direct child */
+		row_end = ijxml_aux__subtree_end(context, i);
+		if (row_tag && !ijxml_aux__token_equals(&tokens[i+1], context->xml, row_tag)) {
+			i = row_end;
+			continue;
+		}
+
+		if (rows == max_rows) {
+			err = IJXML_AUX_BUFFER_TRUNCATED;
+			break;
+		}
+
+		for (j=0; j != num_columns; ++j)
+			ijxml_aux__column_clear(&columns[j], rows);
+
+		j = i+2;
+		while (j < row_end) {
+			if (tokens[j].type == IJXML_ATTRIBUTE_KEY && j+1 < row_end) {
+				column = ijxml_aux__find_column(context, columns, num_columns, IJXML_AUX_BIND_ATTRIBUTE, &tokens[j]);
+				if (column)
+					ijxml_aux__column_value(context, column, rows, tokens[j+1].start, tokens[j+1].end, &err);
+
+				j += 2;
+				continue;
+			}
+
+			if (tokens[j].type != IJXML_OBJECT || j+1 >= row_end) {
+				++j;
+				continue;
+			}
+
+			column = ijxml_aux__find_column(context, columns, num_columns, IJXML_AUX_BIND_ELEMENT, &tokens[j+1]);
+			if (column) {
+				unsigned text_start, text_end;
+
+				j = ijxml_aux__element_text(context, j, &text_start, &text_end);
+				ijxml_aux__column_value(context, column, rows, text_start, text_end, &err);
+			} else {
+				j = ijxml_aux__subtree_end(context, j);
+			}
+		}
+
+		++rows;
+		i = row_end;
+	}
+
+	*num_rows = rows;
+
+	return err;
+}
+
+#if defined(IJXML_NAMESPACES)
+static int ijxml_aux__token_local_equals(struct ijxml_token *tok, unsigned ns, const char *xml, const char *str)
+{
+	unsigned string_len;
+	const char *token_str;
+
+	if (tok->ns != ns)
+		return 0;
+
+	string_len = ijxml_aux__string_len(str);
+	if (string_len != tok->end - tok->local)
+		return 0;
+
+	token_str = &xml[tok->local];
+
+	while (string_len) {
+		if (*token_str != *str)
+			return 0;
+
+		++token_str, ++str, --string_len;
+	}
+
+	return 1;
+}
+
+unsigned ijxml_aux_namespace(struct ijxml_aux_context *context, const struct ijxml_ns_context *ns, const char *uri)
+{
+	unsigned i, uri_len = ijxml_aux__string_len(uri);
+	struct ijxml_ns_uri *current_uri;
+	const char *s, *u;
+	unsigned n;
+
+	for (i=0; i != ns->num_uris; ++i) {
+		current_uri = &ns->uris[i];
+		n = current_uri->end - current_uri->start;
+
+		if (n != uri_len)
+			continue;
+
+		s = &context->xml[current_uri->start];
+		u = uri;
+
+		while (n && *s == *u)
+			++s, ++u, --n;
+
+		if (n == 0)
+			return i;
+	}
+
+	return IJXML_NS_UNKNOWN;
+}
+
+unsigned ijxml_aux_object_by_tag_ns(struct ijxml_aux_context *context, unsigned parent_object_index, unsigned ns, const char *local_name)
+{
+	unsigned i, num_tokens;
+	struct ijxml_token *tokens, *current_token;
+
+	num_tokens = context->num_tokens;
+
+	if (parent_object_index >= num_tokens)
+		return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+	tokens = context->tokens;
+	current_token = &tokens[parent_object_index];
+
+	if (current_token->type != IJXML_OBJECT)
+		return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+	for (i=parent_object_index+1; i+1 < num_tokens; ++i) {
+		current_token = &tokens[i];
+
+		if (current_token->parent != parent_object_index || current_token->type != IJXML_OBJECT)
+			continue;
+
+		++i, ++current_token;
+
+#if defined(IJXML_AUX_USE_ASSERT)
+		assert(current_token->type == IJXML_TAG_NAME);
+#endif
+		if (ijxml_aux__token_local_equals(current_token, ns, context->xml, local_name))
+			return (i-1);
+	}
+
+	return IJXML_AUX_INVALID_TOKEN_OFFSET;
+}
+
+unsigned ijxml_aux_object_attribute_ns(struct ijxml_aux_context *context, unsigned object_index, unsigned ns, const char *local_name)
+{
+	unsigned i, num_tokens;
+	struct ijxml_token *tokens, *current_token;
+
+	num_tokens = context->num_tokens;
+	if (object_index >= num_tokens)
+		return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+	tokens = context->tokens;
+
+	if (tokens[object_index].type != IJXML_OBJECT)
+		return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+	for (i=object_index+1; i < num_tokens; ++i) {
+		current_token = &tokens[i];
+
+		if (current_token->parent != object_index)
+			return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+		if (current_token->type == IJXML_COMMENT || current_token->type == IJXML_TAG_NAME)
+			continue;
+
+		if (current_token->type != IJXML_ATTRIBUTE_KEY || i+1 == num_tokens)
+			return IJXML_AUX_INVALID_TOKEN_OFFSET;
+
+		++i; /* consume attribute value */
+		if (ijxml_aux__token_local_equals(current_token, ns, context->xml, local_name))
+			return i;
+	}
+
+	return IJXML_AUX_INVALID_TOKEN_OFFSET;
+}
+#endif
+
+#endif
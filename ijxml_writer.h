@@ -0,0 +1,293 @@
+#ifndef _IJXML_WRITER_H_
+#define _IJXML_WRITER_H_
+
+#include "ijxml.h"
+
+typedef enum {
+	IJXML_WRITER_FLUSH_FAILED = -1,
+	IJXML_WRITER_INVALID_EDIT = -2,
+	IJXML_WRITER_MALFORMED_INPUT = -3,
+	IJXML_WRITER_TOO_MANY_ATTRIBUTES = -4,
+
+	IJXML_WRITER_SUCCESS = 0
+} ijxml_writer_err_t;
+
+/* receives the output, returns 0 on failure */
+typedef int (*ijxml_writer_flush_fn)(void *user, const char *data, unsigned len);
+
+typedef struct ijxml_writer {
+	char *buffer;
+	unsigned buffer_size;
+	unsigned len;
+	int open_tag;		/* '<name ...' written, '>' or '/>' still pending */
+	int error;
+
+	ijxml_writer_flush_fn flush;
+	void *user;
+} ijxml_writer;
+
+typedef enum {
+	IJXML_WRITER_REPLACE,		/* text of ATTRIBUTE_VALUE, STRING and VALUE tokens is escaped, anything else is written as is */
+	IJXML_WRITER_DELETE,		/* deleting an ATTRIBUTE_KEY removes the whole attribute. TAG_NAMEs can not be replaced or deleted, replace the OBJECT */
+	IJXML_WRITER_INSERT_BEFORE,
+	IJXML_WRITER_INSERT_AFTER	/* after an ATTRIBUTE_KEY means after its value, after a TAG_NAME adds attributes first */
+} ijxml_writer_op_t;
+
+typedef struct ijxml_writer_edit {
+	unsigned token;
+	ijxml_writer_op_t op;
+	const char *data;
+	unsigned len;
+} ijxml_writer_edit;
+
+/* 'buffer' collects small writes, spans of at least 'buffer_size' bytes are passed to 'flush' without being copied */
+void ijxml_writer_init(struct ijxml_writer *writer, char *buffer, unsigned buffer_size, ijxml_writer_flush_fn flush, void *user);
+
+/* returns the sticky error of the writer */
+int ijxml_writer_flush(struct ijxml_writer *writer);
+
+void ijxml_writer_raw(struct ijxml_writer *writer, const char *data, unsigned len);
+void ijxml_writer_begin_element(struct ijxml_writer *writer, const char *name);
+void ijxml_writer_attribute(struct ijxml_writer *writer, const char *name, const char *value);
+void ijxml_writer_text(struct ijxml_writer *writer, const char *text);
+/* writes '/>' if the element has no content */
+void ijxml_writer_end_element(struct ijxml_writer *writer, const char *name);
+
+/* Writes 'xml' with the edits applied, everything in between is copied as untouched spans of the source.
+ * Edits have to be ordered by position in the document and must not overlap, nothing is written if one of them is
+ * invalid. Does not flush the writer. */
+int ijxml_writer_rewrite(struct ijxml_writer *writer, const char *xml, unsigned xml_len, const struct ijxml_token *tokens, unsigned num_tokens, const struct ijxml_writer_edit *edits, unsigned num_edits);
+
+/* ijxml_canonicalize into the writer ('flags' are ijxml_canonical_flags_t), does not flush the writer */
+int ijxml_writer_canonicalize(struct ijxml_writer *writer, const char *xml, unsigned xml_len, unsigned flags, ijxml_hash_t *hash);
+
+#endif
+
+#if defined(IJXML_WRITER_IMPLEMENTATION)
+
+void ijxml_writer_init(struct ijxml_writer *writer, char *buffer, unsigned buffer_size, ijxml_writer_flush_fn flush, void *user)
+{
+	writer->buffer = buffer;
+	writer->buffer_size = buffer_size;
+	writer->len = 0u;
+	writer->open_tag = 0;
+	writer->error = IJXML_WRITER_SUCCESS;
+	writer->flush = flush;
+	writer->user = user;
+}
+
+static unsigned ijxml_writer__string_len(const char *s)
+{
+	const char *eos = s;
+	while(*eos)
+		++eos;
+
+	return (unsigned)(eos - s);
+}
+
+static void ijxml_writer__buffer_copy(char *dest, const char *source, unsigned len)
+{
+	while (len--)
+		*dest++ = *source++;
+}
+
+int ijxml_writer_flush(struct ijxml_writer *writer)
+{
+	if (writer->error == IJXML_WRITER_SUCCESS && writer->len) {
+		if (!writer->flush(writer->user, writer->buffer, writer->len))
+			writer->error = IJXML_WRITER_FLUSH_FAILED;
+	}
+
+	writer->len = 0u;
+
+	return writer->error;
+}
+
+void ijxml_writer_raw(struct ijxml_writer *writer, const char *data, unsigned len)
+{
+	if (writer->error != IJXML_WRITER_SUCCESS || len == 0)
+		return;
+
+	if (len <= writer->buffer_size - writer->len) {
+		ijxml_writer__buffer_copy(writer->buffer + writer->len, data, len);
+		writer->len += len;
+		return;
+	}
+
+	if (ijxml_writer_flush(writer) != IJXML_WRITER_SUCCESS)
+		return;
+
+	if (len < writer->buffer_size) {
+		ijxml_writer__buffer_copy(writer->buffer, data, len);
+		writer->len = len;
+		return;
+	}
+
+	if (!writer->flush(writer->user, data, len))
+		writer->error = IJXML_WRITER_FLUSH_FAILED;
+}
+
+/* ijxml_output_fn writing to a writer */
+static int ijxml_writer__output(void *user, const char *data, unsigned len)
+{
+	struct ijxml_writer *writer = (struct ijxml_writer *)user;
+
+	ijxml_writer_raw(writer, data, len);
+
+	return writer->error == IJXML_WRITER_SUCCESS;
+}
+
+static void ijxml_writer__escaped(struct ijxml_writer *writer, const char *text, unsigned len)
+{
+	ijxml_escape(text, len, ijxml_writer__output, writer);
+}
+
+static void ijxml_writer__close_tag(struct ijxml_writer *writer)
+{
+	if (writer->open_tag) {
+		ijxml_writer_raw(writer, ">", 1);
+		writer->open_tag = 0;
+	}
+}
+
+void ijxml_writer_begin_element(struct ijxml_writer *writer, const char *name)
+{
+	ijxml_writer__close_tag(writer);
+	ijxml_writer_raw(writer, "<", 1);
+	ijxml_writer_raw(writer, name, ijxml_writer__string_len(name));
+	writer->open_tag = 1;
+}
+
+void ijxml_writer_attribute(struct ijxml_writer *writer, const char *name, const char *value)
+{
+	ijxml_writer_raw(writer, " ", 1);
+	ijxml_writer_raw(writer, name, ijxml_writer__string_len(name));
+	ijxml_writer_raw(writer, "=\"", 2);
+	ijxml_writer__escaped(writer, value, ijxml_writer__string_len(value));
+	ijxml_writer_raw(writer, "\"", 1);
+}
+
+void ijxml_writer_text(struct ijxml_writer *writer, const char *text)
+{
+	ijxml_writer__close_tag(writer);
+	ijxml_writer__escaped(writer, text, ijxml_writer__string_len(text));
+}
+
+void ijxml_writer_end_element(struct ijxml_writer *writer, const char *name)
+{
+	if (writer->open_tag) {
+		ijxml_writer_raw(writer, "/>", 2);
+		writer->open_tag = 0;
+		return;
+	}
+
+	ijxml_writer_raw(writer, "</", 2);
+	ijxml_writer_raw(writer, name, ijxml_writer__string_len(name));
+	ijxml_writer_raw(writer, ">", 1);
+}
+
+/* the source bytes [*from, *to) the edit replaces, an empty range for insertions */
+static int ijxml_writer__edit_range(const struct ijxml_token *tokens, unsigned num_tokens, const struct ijxml_writer_edit *edit, unsigned *from, unsigned *to)
+{
+	const struct ijxml_token *token, *value;
+	unsigned start, end;
+
+	if (edit->token >= num_tokens)
+		return 0;
+
+	token = &tokens[edit->token];
+	if (token->start == (unsigned)-1 || token->end == (unsigned)-1)
+		return 0;
+
+	/* the end tag would keep the old name */
+	if (token->type == IJXML_TAG_NAME && (edit->op == IJXML_WRITER_REPLACE || edit->op == IJXML_WRITER_DELETE))
+		return 0;
+
+	start = token->start;
+	end = token->end;
+
+	if (token->type == IJXML_ATTRIBUTE_KEY && (edit->op == IJXML_WRITER_DELETE || edit->op == IJXML_WRITER_INSERT_AFTER)) {
+		if (edit->token+1 >= num_tokens)
+			return 0;
+
+		value = token + 1;
+		if (value->type != IJXML_ATTRIBUTE_VALUE)
+			return 0;
+
+		end = value->end + 1;	/* closing quote */
+
+		if (edit->op == IJXML_WRITER_DELETE) {
+			/* take the whitespace in front of the attribute with it */
+			const struct ijxml_token *previous = token - 1;
+			start = previous->end + (previous->type == IJXML_ATTRIBUTE_VALUE ? 1 : 0);
+		}
+	}
+
+	switch (edit->op) {
+		case IJXML_WRITER_REPLACE : case IJXML_WRITER_DELETE :
+			*from = start;
+			*to = end;
+			break;
+
+		case IJXML_WRITER_INSERT_BEFORE :
+			*from = *to = start;
+			break;
+
+		case IJXML_WRITER_INSERT_AFTER :
+			*from = *to = end;
+			break;
+
+		default:
+			return 0;
+	}
+
+	return 1;
+}
+
+int ijxml_writer_rewrite(struct ijxml_writer *writer, const char *xml, unsigned xml_len, const struct ijxml_token *tokens, unsigned num_tokens, const struct ijxml_writer_edit *edits, unsigned num_edits)
+{
+	unsigned i, from, to, cursor = 0u;
+	const struct ijxml_writer_edit *edit;
+	ijxmltype_t type;
+
+	/* all edits are checked up front so a refused one does not leave a partial document behind */
+	for (i=0; i != num_edits; ++i) {
+		if (!ijxml_writer__edit_range(tokens, num_tokens, &edits[i], &from, &to) || from < cursor || to > xml_len)
+			return IJXML_WRITER_INVALID_EDIT;
+
+		cursor = to;
+	}
+
+	cursor = 0u;
+	for (i=0; i != num_edits; ++i) {
+		edit = &edits[i];
+		ijxml_writer__edit_range(tokens, num_tokens, edit, &from, &to);
+
+		ijxml_writer_raw(writer, xml + cursor, from - cursor);
+
+		type = tokens[edit->token].type;
+		if (edit->op == IJXML_WRITER_REPLACE && (type == IJXML_ATTRIBUTE_VALUE || type == IJXML_STRING || type == IJXML_VALUE))
+			ijxml_writer__escaped(writer, edit->data, edit->len);
+		else if (edit->op != IJXML_WRITER_DELETE)
+			ijxml_writer_raw(writer, edit->data, edit->len);
+
+		cursor = to;
+	}
+
+	ijxml_writer_raw(writer, xml + cursor, xml_len - cursor);
+
+	return writer->error;
+}
+
+int ijxml_writer_canonicalize(struct ijxml_writer *writer, const char *xml, unsigned xml_len, unsigned flags, ijxml_hash_t *hash)
+{
+	ijxml_writer__close_tag(writer);
+
+	switch (ijxml_canonicalize(xml, xml_len, flags, ijxml_writer__output, writer, hash)) {
+		case IJXML_CANONICAL_MALFORMED : return IJXML_WRITER_MALFORMED_INPUT;
+		case IJXML_CANONICAL_TOO_MANY_ATTRIBUTES : return IJXML_WRITER_TOO_MANY_ATTRIBUTES;
+		default: return writer->error;
+	}
+}
+
+#endif
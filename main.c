@@ -1,8 +1,12 @@
 
+/* built twice, as is and with IJXML_NAMESPACES, IJXML_VALIDATE_UTF8 and IJXML_HASH64 defined (see premake4.lua) */
 #define IJXML_AUX_USE_ASSERT
 #define IJXML_AUX_IMPLEMENTATION
 #include "ijxml_aux.h"
 
+#define IJXML_WRITER_IMPLEMENTATION
+#include "ijxml_writer.h"
+
 #define IJXML_IMPLEMENTATION
 #include "ijxml.h"
 
@@ -14,6 +18,7 @@
 #include <stdarg.h>     /* va_list, va_start, va_arg, va_end */
 #include <stdlib.h>		/* system, free, realloc, ... */
 #include <string.h>		/* memcpy */
+#include <stddef.h>		/* offsetof */
 
 #include <assert.h>
 
@@ -27,6 +32,12 @@
 
 #define XML_ENSURE(cond) assert((cond))
 
+#if defined(IJXML_VALIDATE_UTF8)
+	#define TEST_UTF8_ERROR 1
+#else
+	#define TEST_UTF8_ERROR 0
+#endif
+
 #define LOG_TEMP_BUFFER_SIZE (32*1024)
 static void test_log(const char *msg_format, ...)
 {
@@ -188,6 +199,775 @@ static void test_reallocation_parsing(void)
 	}
 }
 
+static const char xml_namespaces[] =
+	"<s:Envelope xmlns:s=\"urn:soap\" xmlns=\"urn:default\">"
+		"<soap:Body xmlns:soap=\"urn:soap\" soap:mustUnderstand=\"1\" id=\"b\">"
+			"<item xmlns=\"\">plain</item>"
+			"<entry>defaulted</entry>"
+		"</soap:Body>"
+	"</s:Envelope>";
+
+#if defined(IJXML_NAMESPACES)
+static void test_namespaces(void)
+{
+	struct ijxml_parser parser;
+	struct ijxml_ns_context ns;
+	struct ijxml_ns_binding bindings[8];
+	struct ijxml_ns_uri uris[8];
+	struct ijxml_token tokens[32];
+	struct ijxml_parse_result res;
+	struct ijxml_aux_context ctx;
+	unsigned soap_ns, default_ns, body, token_index;
+
+	ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+	res = ijxml_parse(&parser, xml_namespaces, (unsigned)strlen(xml_namespaces), tokens, 32);
+	XML_ENSURE(res.error == 0);
+	XML_ENSURE(ns.num_bindings == 0);
+	XML_ENSURE(ns.num_uris == 2);
+
+	ijxml_aux_init(&ctx, xml_namespaces, tokens, parser.toknext);
+
+	soap_ns = ijxml_aux_namespace(&ctx, &ns, "urn:soap");
+	default_ns = ijxml_aux_namespace(&ctx, &ns, "urn:default");
+	XML_ENSURE(soap_ns != IJXML_NS_NONE && default_ns != IJXML_NS_NONE && soap_ns != default_ns);
+	XML_ENSURE(ijxml_aux_namespace(&ctx, &ns, "urn:missing") == IJXML_NS_UNKNOWN);
+
+	XML_ENSURE(tokens[1].ns == soap_ns);
+
+	/* different prefixes bound to the same URI resolve to the same id */
+	body = ijxml_aux_object_by_tag_ns(&ctx, 0, soap_ns, "Body");
+	XML_ENSURE(body != IJXML_AUX_INVALID_TOKEN_OFFSET);
+	XML_ENSURE(ijxml_aux_object_by_tag_ns(&ctx, 0, default_ns, "Body") == IJXML_AUX_INVALID_TOKEN_OFFSET);
+
+	token_index = ijxml_aux_object_attribute_ns(&ctx, body, soap_ns, "mustUnderstand");
+	XML_ENSURE(ijxml_aux_token_equals(&ctx, token_index, "1"));
+	XML_ENSURE(ijxml_aux_object_attribute_ns(&ctx, body, soap_ns, "id") == IJXML_AUX_INVALID_TOKEN_OFFSET);
+	XML_ENSURE(ijxml_aux_object_attribute_ns(&ctx, body, IJXML_NS_NONE, "id") != IJXML_AUX_INVALID_TOKEN_OFFSET);
+
+	XML_ENSURE(ijxml_aux_object_by_tag_ns(&ctx, body, IJXML_NS_NONE, "item") != IJXML_AUX_INVALID_TOKEN_OFFSET);
+	XML_ENSURE(ijxml_aux_object_by_tag_ns(&ctx, body, ijxml_aux_namespace(&ctx, &ns, "urn:missing"), "item") == IJXML_AUX_INVALID_TOKEN_OFFSET);
+	XML_ENSURE(ijxml_aux_object_by_tag_ns(&ctx, body, default_ns, "entry") != IJXML_AUX_INVALID_TOKEN_OFFSET);
+
+	/* restarting after token exhaustion must unwind the bindings of the rewound objects */
+	{
+		struct ijxml_token realloc_tokens[32];
+		unsigned num_tokens = 0, num_static_tokens = parser.toknext;
+
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		do {
+			++num_tokens;
+			res = ijxml_parse(&parser, xml_namespaces, (unsigned)strlen(xml_namespaces), realloc_tokens, num_tokens);
+		} while (res.error == 1);
+
+		XML_ENSURE(parser.toknext == num_static_tokens);
+		XML_ENSURE(memcmp(tokens, realloc_tokens, sizeof(struct ijxml_token)*num_static_tokens) == 0);
+	}
+
+	/* incremental updates resolve against the bindings of the enclosing elements */
+	{
+		char edited[sizeof(xml_namespaces) + 8];
+		struct ijxml_token full_tokens[32];
+		unsigned edit_start = (unsigned)(strstr(xml_namespaces, "defaulted") - xml_namespaces);
+		unsigned num_tokens;
+
+		sprintf(edited, "%.*s%s%s", (int)edit_start, xml_namespaces, "changed", xml_namespaces + edit_start + 9);
+
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		XML_ENSURE(ijxml_parse(&parser, edited, (unsigned)strlen(edited), full_tokens, 32).error == 0);
+		num_tokens = parser.toknext;
+
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		XML_ENSURE(ijxml_parse(&parser, xml_namespaces, (unsigned)strlen(xml_namespaces), tokens, 32).error == 0);
+		XML_ENSURE(ijxml_reparse(&parser, edited, (unsigned)strlen(edited), tokens, 32, edit_start, 9, 7).error == 0);
+		XML_ENSURE(ns.num_bindings == 0 && ns.num_uris == 2);
+
+		XML_ENSURE(parser.toknext == num_tokens);
+		XML_ENSURE(memcmp(tokens, full_tokens, sizeof(struct ijxml_token)*num_tokens) == 0);
+	}
+
+	/* declarations behind the edit are re-interned inside the reparsed subtree */
+	{
+		static const char before[] = "<r xmlns:a=\"x\"><b xmlns:p=\"u2\"><p:c/></b></r>";
+		static const char after[] = "<r xmlns:a=\"x\"><d/><b xmlns:p=\"u2\"><p:c/></b></r>";
+		struct ijxml_token full_tokens[32];
+		unsigned num_tokens, b;
+
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		XML_ENSURE(ijxml_parse(&parser, after, (unsigned)strlen(after), full_tokens, 32).error == 0);
+		num_tokens = parser.toknext;
+
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		XML_ENSURE(ijxml_parse(&parser, before, (unsigned)strlen(before), tokens, 32).error == 0);
+		XML_ENSURE(ijxml_reparse(&parser, after, (unsigned)strlen(after), tokens, 32, 15, 0, 4).error == 0);
+		XML_ENSURE(ns.num_uris == 2 && ns.uris[1].start == (unsigned)(strstr(after, "u2") - after));
+
+		XML_ENSURE(parser.toknext == num_tokens);
+		XML_ENSURE(memcmp(tokens, full_tokens, sizeof(struct ijxml_token)*num_tokens) == 0);
+
+		ijxml_aux_init(&ctx, after, tokens, parser.toknext);
+		b = ijxml_aux_object_by_tag(&ctx, 0, "b");
+		XML_ENSURE(ijxml_aux_object_by_tag_ns(&ctx, b, ijxml_aux_namespace(&ctx, &ns, "u2"), "c") != IJXML_AUX_INVALID_TOKEN_OFFSET);
+
+		/* a rejected edit leaves the URIs where they were */
+		ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+		XML_ENSURE(ijxml_parse(&parser, before, (unsigned)strlen(before), tokens, 32).error == 0);
+		XML_ENSURE(ijxml_reparse(&parser, "<r xmlns:a=\"x\"><d><b xmlns:p=\"u2\"><p:c/></b></r>", 48, tokens, 32, 15, 0, 3).error == 1);
+		XML_ENSURE(ns.num_uris == 2 && ns.uris[1].start == (unsigned)(strstr(before, "u2") - before));
+	}
+
+	/* undeclared prefix */
+	ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+	res = ijxml_parse(&parser, "<a:b></a:b>", 11, tokens, 32);
+	XML_ENSURE(res.error == 1);
+}
+#endif
+
+static void check_reparse(const char *before, const char *after, unsigned edit_start, unsigned removed_len, unsigned inserted_len)
+{
+	struct ijxml_parser parser, full_parser;
+	struct ijxml_token tokens[64], full_tokens[64];
+	struct ijxml_parse_result res;
+
+	ijxml_parser_init(&parser);
+	res = ijxml_parse(&parser, before, (unsigned)strlen(before), tokens, 64);
+	XML_ENSURE(res.error == 0);
+
+	res = ijxml_reparse(&parser, after, (unsigned)strlen(after), tokens, 64, edit_start, removed_len, inserted_len);
+	XML_ENSURE(res.error == 0);
+
+	ijxml_parser_init(&full_parser);
+	res = ijxml_parse(&full_parser, after, (unsigned)strlen(after), full_tokens, 64);
+	XML_ENSURE(res.error == 0);
+
+	XML_ENSURE(parser.toknext == full_parser.toknext);
+	XML_ENSURE(memcmp(tokens, full_tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+}
+
+static void test_reparse(void)
+{
+	const char *before = "<a x=\"1\"><b y=\"22\"><c/></b><d>text</d></a>";
+
+	/* attribute value grows and shrinks */
+	check_reparse(before, "<a x=\"1\"><b y=\"2222\"><c/></b><d>text</d></a>", 15, 2, 4);
+	check_reparse(before, "<a x=\"1\"><b y=\"\"><c/></b><d>text</d></a>", 15, 2, 0);
+
+	/* inserting and removing elements changes the number of tokens */
+	check_reparse(before, "<a x=\"1\"><b y=\"22\"><c/><e k=\"v\">t</e></b><d>text</d></a>", 23, 0, 14);
+	check_reparse(before, "<a x=\"1\"><b y=\"22\"><c/></b><d>text<e/><f/><g/></d></a>", 34, 0, 12);
+	check_reparse(before, "<a x=\"1\"><b y=\"22\"></b><d>text</d></a>", 19, 4, 0);
+	check_reparse(before, "<a x=\"1\"><d>text</d></a>", 9, 18, 0);
+
+	/* edit of the root itself */
+	check_reparse(before, "<a x=\"12\"><b y=\"22\"><c/></b><d>text</d></a>", 6, 1, 2);
+
+	/* edits breaking the enclosing object are rejected and leave the tokens untouched */
+	{
+		struct ijxml_parser parser;
+		struct ijxml_token tokens[64], untouched[64];
+		const char *broken = "<a x=\"1\"><b y=\"22\"><c/><d>text</d></a>";
+
+		ijxml_parser_init(&parser);
+		XML_ENSURE(ijxml_parse(&parser, before, (unsigned)strlen(before), tokens, 64).error == 0);
+		memcpy(untouched, tokens, sizeof(tokens));
+
+		XML_ENSURE(ijxml_reparse(&parser, broken, (unsigned)strlen(broken), tokens, 64, 23, 4, 0).error == 1);
+		XML_ENSURE(memcmp(untouched, tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+	}
+
+	/* an object whose new text starts with a close tag */
+	{
+		struct ijxml_parser parser;
+		struct ijxml_token tokens[64], untouched[64];
+		const char *original = "<e1><e0 k0=\"v74\" /></e>";
+		const char *broken = "<e1></0=\"v74\" /></e>";
+
+		memset(tokens, 0, sizeof(tokens));
+		ijxml_parser_init(&parser);
+		XML_ENSURE(ijxml_parse(&parser, original, (unsigned)strlen(original), tokens, 64).error == 0);
+		memcpy(untouched, tokens, sizeof(tokens));
+
+		XML_ENSURE(ijxml_reparse(&parser, broken, (unsigned)strlen(broken), tokens, 64, 5, 4, 1).error == 1);
+		XML_ENSURE(memcmp(untouched, tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+	}
+}
+
+static void test_index(void)
+{
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[32];
+	struct ijxml_aux_context ctx;
+	unsigned index[512];
+	unsigned xml_len = (unsigned)strlen(xml_namespaces), index_size, body;
+	char changed[sizeof(xml_namespaces)];
+#if defined(IJXML_NAMESPACES)
+	struct ijxml_ns_context ns, loaded_ns;
+	struct ijxml_ns_binding bindings[8];
+	struct ijxml_ns_uri uris[8];
+
+	ijxml_parser_init_ns(&parser, &ns, bindings, 8, uris, 8);
+	XML_ENSURE(ijxml_parse(&parser, xml_namespaces, xml_len, tokens, 32).error == 0);
+
+	XML_ENSURE(ijxml_aux_index_write(index, 16, xml_namespaces, xml_len, tokens, parser.toknext, &ns) == 0);
+	index_size = ijxml_aux_index_write(index, sizeof(index), xml_namespaces, xml_len, tokens, parser.toknext, &ns);
+	XML_ENSURE(index_size == ijxml_aux_index_size(parser.toknext, ns.num_uris));
+
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, index_size, xml_namespaces, xml_len, 1, &loaded_ns) == IJXML_AUX_SUCCESS);
+	XML_ENSURE(ctx.num_tokens == parser.toknext);
+	XML_ENSURE(memcmp(ctx.tokens, tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+
+	body = ijxml_aux_object_by_tag_ns(&ctx, 0, ijxml_aux_namespace(&ctx, &loaded_ns, "urn:soap"), "Body");
+	XML_ENSURE(body != IJXML_AUX_INVALID_TOKEN_OFFSET);
+#else
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, xml_namespaces, xml_len, tokens, 32).error == 0);
+
+	XML_ENSURE(ijxml_aux_index_write(index, 16, xml_namespaces, xml_len, tokens, parser.toknext, 0) == 0);
+	index_size = ijxml_aux_index_write(index, sizeof(index), xml_namespaces, xml_len, tokens, parser.toknext, 0);
+	XML_ENSURE(index_size == ijxml_aux_index_size(parser.toknext, 0));
+
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, index_size, xml_namespaces, xml_len, 1, 0) == IJXML_AUX_SUCCESS);
+	XML_ENSURE(ctx.num_tokens == parser.toknext);
+	XML_ENSURE(memcmp(ctx.tokens, tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+
+	body = ijxml_aux_object_by_tag(&ctx, 0, "soap:Body");
+	XML_ENSURE(body != IJXML_AUX_INVALID_TOKEN_OFFSET);
+#endif
+
+	/* stale or truncated indices are refused */
+	memcpy(changed, xml_namespaces, sizeof(changed));
+	changed[xml_len-2] = 'X';
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, index_size, changed, xml_len, 1, 0) == IJXML_AUX_INDEX_MISMATCH);
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, index_size, xml_namespaces, xml_len-1, 0, 0) == IJXML_AUX_INDEX_MISMATCH);
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, index_size-1, xml_namespaces, xml_len, 0, 0) == IJXML_AUX_INDEX_MISMATCH);
+
+	/* counts whose size would wrap around are refused, not truncated */
+	XML_ENSURE(ijxml_aux_index_size(((unsigned)-1) / sizeof(struct ijxml_token) + 1, 0) == 0);
+	XML_ENSURE(ijxml_aux_index_write(index, (unsigned)-1, xml_namespaces, xml_len, tokens, ((unsigned)-1) / sizeof(struct ijxml_token) + 1, 0) == 0);
+	((struct ijxml_aux_index_header *)index)->num_tokens = ((unsigned)-1) / sizeof(struct ijxml_token) + 1;
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, 256, xml_namespaces, xml_len, 0, 0) == IJXML_AUX_INDEX_MISMATCH);
+	((struct ijxml_aux_index_header *)index)->num_tokens = 0;
+	((struct ijxml_aux_index_header *)index)->num_uris = (unsigned)-1;
+	XML_ENSURE(ijxml_aux_index_init(&ctx, index, 256, xml_namespaces, xml_len, 0, 0) == IJXML_AUX_INDEX_MISMATCH);
+}
+
+typedef struct test_output {
+	char data[1024];
+	unsigned len;
+	unsigned num_flushes;
+} test_output;
+
+static int test_output_flush(void *user, const char *data, unsigned len)
+{
+	struct test_output *output = (struct test_output *)user;
+
+	if (output->len + len >= sizeof(output->data))
+		return 0;
+
+	memcpy(output->data + output->len, data, len);
+	output->len += len;
+	output->data[output->len] = 0;
+	++output->num_flushes;
+
+	return 1;
+}
+
+static void test_writer(void)
+{
+	struct ijxml_writer writer;
+	struct test_output output;
+	char buffer[16];
+
+	output.len = output.num_flushes = 0;
+	ijxml_writer_init(&writer, buffer, sizeof(buffer), test_output_flush, &output);
+
+	ijxml_writer_begin_element(&writer, "root");
+	ijxml_writer_attribute(&writer, "a", "1 & \"2\"");
+	ijxml_writer_begin_element(&writer, "empty");
+	ijxml_writer_end_element(&writer, "empty");
+	ijxml_writer_text(&writer, "x < y");
+	ijxml_writer_end_element(&writer, "root");
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_SUCCESS);
+
+	XML_ENSURE(strcmp(output.data, "<root a=\"1 &amp; &quot;2&quot;\"><empty/>x &lt; y</root>") == 0);
+
+	/* failing sinks make the writer fail */
+	output.len = sizeof(output.data) - 1;
+	ijxml_writer_raw(&writer, "more than sixteen bytes", 23);
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_FLUSH_FAILED);
+}
+
+static void test_rewrite(void)
+{
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[32];
+	struct ijxml_aux_context ctx;
+	struct ijxml_writer writer;
+	struct test_output output;
+	struct ijxml_writer_edit edits[5];
+	unsigned xml_len = (unsigned)strlen(xml), property;
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, xml, xml_len, tokens, 32).error == 0);
+	ijxml_aux_init(&ctx, xml, tokens, parser.toknext);
+
+	edits[0].token = ijxml_aux_tag(&ctx, 0);
+	edits[0].op = IJXML_WRITER_INSERT_AFTER;
+	edits[0].data = " version=\"2\"";
+	edits[0].len = (unsigned)strlen(edits[0].data);
+
+	edits[1].token = ijxml_aux_object_attribute(&ctx, 0, "class");
+	edits[1].op = IJXML_WRITER_REPLACE;
+	edits[1].data = "A&B";
+	edits[1].len = 3;
+
+	edits[2].token = ijxml_aux_object_attribute(&ctx, 0, "id") - 1;
+	edits[2].op = IJXML_WRITER_DELETE;
+	edits[2].data = 0;
+	edits[2].len = 0;
+
+	property = ijxml_aux_object_at(&ctx, 0, 0);
+	edits[3].token = property;
+	edits[3].op = IJXML_WRITER_INSERT_BEFORE;
+	edits[3].data = "<first/>";
+	edits[3].len = 8;
+
+	edits[4].token = ijxml_aux_object_at(&ctx, 0, 1);
+	edits[4].op = IJXML_WRITER_DELETE;
+	edits[4].data = 0;
+	edits[4].len = 0;
+
+	/* unbuffered, untouched spans reach the sink as they are */
+	output.len = output.num_flushes = 0;
+	ijxml_writer_init(&writer, 0, 0, test_output_flush, &output);
+	XML_ENSURE(ijxml_writer_rewrite(&writer, xml, xml_len, tokens, parser.toknext, edits, 5) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_SUCCESS);
+
+	XML_ENSURE(strcmp(output.data,
+		"<object version=\"2\" empty_attribute=\"\" class=\"A&amp;B\">"
+			"<first/>"
+			"<property name=\"name_value\">"
+				"<value>empty_event</value>"
+			"</property>"
+		"</object>") == 0);
+
+	/* edits out of document order are refused before anything is written */
+	XML_ENSURE(ijxml_writer_rewrite(&writer, xml, xml_len, tokens, parser.toknext, edits+3, 1) == IJXML_WRITER_SUCCESS);
+	output.len = 0;
+	edits[0] = edits[4];
+	XML_ENSURE(ijxml_writer_rewrite(&writer, xml, xml_len, tokens, parser.toknext, edits, 4) == IJXML_WRITER_INVALID_EDIT);
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_SUCCESS && output.len == 0);
+
+	/* renaming only the start tag would leave the end tag behind */
+	edits[0].token = ijxml_aux_tag(&ctx, property);
+	edits[0].op = IJXML_WRITER_REPLACE;
+	edits[0].data = "renamed";
+	edits[0].len = 7;
+	XML_ENSURE(ijxml_writer_rewrite(&writer, xml, xml_len, tokens, parser.toknext, edits, 1) == IJXML_WRITER_INVALID_EDIT);
+	edits[0].op = IJXML_WRITER_DELETE;
+	XML_ENSURE(ijxml_writer_rewrite(&writer, xml, xml_len, tokens, parser.toknext, edits, 1) == IJXML_WRITER_INVALID_EDIT);
+}
+
+static void test_canonicalize(void)
+{
+	static const char messy[] =
+		"\xEF\xBB\xBF<?xml version=\"1.0\"?>\n"
+		"<!DOCTYPE doc [ <!ENTITY e \"x\"> ]>\n"
+		"<doc  z='say \"hi\"'   a = \"1\" >\n"
+		"\t<!-- comment -->\n"
+		"\t<empty></empty >\n"
+		"\t<text> a &amp; b </text>\n"
+		"\t<?pi data?>\n"
+		"\t<cdata><![CDATA[<x> & y]]></cdata>\n"
+		"\t<self b='2' a='1'/>\n"
+		"</doc >\n";
+	static const char tidy[] = "<doc a=\"1\" z='say \"hi\"'><empty/><text> a &amp; b </text><cdata>&lt;x&gt; &amp; y</cdata><self a=\"1\" b=\"2\"></self></doc>";
+	struct ijxml_writer writer;
+	struct test_output output;
+	char buffer[16];
+	ijxml_hash_t hash, tidy_hash;
+
+	output.len = output.num_flushes = 0;
+	ijxml_writer_init(&writer, buffer, sizeof(buffer), test_output_flush, &output);
+	XML_ENSURE(ijxml_writer_canonicalize(&writer, messy, (unsigned)strlen(messy), 0, 0) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(strcmp(output.data, "<doc z=\"say &quot;hi&quot;\" a=\"1\"><empty/><text> a &amp; b </text><cdata>&lt;x&gt; &amp; y</cdata><self b=\"2\" a=\"1\"/></doc>") == 0);
+
+	/* sorted, the hash is the hash of the output and equal for equivalent documents */
+	output.len = 0;
+	XML_ENSURE(ijxml_writer_canonicalize(&writer, messy, (unsigned)strlen(messy), IJXML_CANONICAL_SORT_ATTRIBUTES, &hash) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(ijxml_writer_flush(&writer) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(strcmp(output.data, "<doc a=\"1\" z=\"say &quot;hi&quot;\"><empty/><text> a &amp; b </text><cdata>&lt;x&gt; &amp; y</cdata><self a=\"1\" b=\"2\"/></doc>") == 0);
+	XML_ENSURE(hash == ijxml_aux_hash(output.data, output.len));
+
+	XML_ENSURE(ijxml_writer_canonicalize(&writer, tidy, (unsigned)strlen(tidy), IJXML_CANONICAL_SORT_ATTRIBUTES, &tidy_hash) == IJXML_WRITER_SUCCESS);
+	XML_ENSURE(hash == tidy_hash);
+
+	XML_ENSURE(ijxml_writer_canonicalize(&writer, "<a b=\"1></a>", 12, 0, 0) == IJXML_WRITER_MALFORMED_INPUT);
+	XML_ENSURE(ijxml_writer_canonicalize(&writer, "<a><!-- x </a>", 14, 0, 0) == IJXML_WRITER_MALFORMED_INPUT);
+
+	/* straight to a sink, which can fail */
+	output.len = 0;
+	XML_ENSURE(ijxml_canonicalize(tidy, (unsigned)strlen(tidy), IJXML_CANONICAL_SORT_ATTRIBUTES, test_output_flush, &output, &hash) == IJXML_CANONICAL_SUCCESS);
+	XML_ENSURE(hash == tidy_hash && hash == ijxml_hash(IJXML_HASH_SEED, output.data, output.len));
+#if defined(IJXML_HASH64)
+	XML_ENSURE(ijxml_hash(IJXML_HASH_SEED, "a", 1) == 0xaf63dc4c8601ec8cull);
+#else
+	XML_ENSURE(ijxml_hash(IJXML_HASH_SEED, "a", 1) == 0xe40c292cu);
+#endif
+	output.len = sizeof(output.data) - 8;
+	XML_ENSURE(ijxml_canonicalize(tidy, (unsigned)strlen(tidy), 0, test_output_flush, &output, 0) == IJXML_CANONICAL_OUTPUT_FAILED);
+
+	/* start and end tags have to balance */
+	output.len = 0;
+	XML_ENSURE(ijxml_canonicalize("<a>", 3, 0, test_output_flush, &output, 0) == IJXML_CANONICAL_MALFORMED);
+	XML_ENSURE(ijxml_canonicalize("<a><b/>", 7, 0, test_output_flush, &output, 0) == IJXML_CANONICAL_MALFORMED);
+	XML_ENSURE(ijxml_canonicalize("<a><b></b>text", 14, 0, test_output_flush, &output, 0) == IJXML_CANONICAL_MALFORMED);
+	XML_ENSURE(ijxml_canonicalize("<a/></a>", 8, 0, test_output_flush, &output, 0) == IJXML_CANONICAL_MALFORMED);
+
+	{
+		char many[40*6+8];
+		unsigned i, len = 2;
+
+		memcpy(many, "<a", 2);
+		for (i=0; i != IJXML_CANONICAL_MAX_ATTRIBUTES+1; ++i)
+			len += (unsigned)sprintf(many + len, " k%u=''", i);
+		memcpy(many + len, "/>", 2);
+		len += 2;
+
+		output.len = 0;
+		XML_ENSURE(ijxml_canonicalize(many, len, 0, test_output_flush, &output, 0) == IJXML_CANONICAL_SUCCESS);
+		XML_ENSURE(ijxml_canonicalize(many, len, IJXML_CANONICAL_SORT_ATTRIBUTES, test_output_flush, &output, 0) == IJXML_CANONICAL_TOO_MANY_ATTRIBUTES);
+	}
+}
+
+static void test_utf8(void)
+{
+	/* BOM, non-ASCII names, attribute values and text */
+	static const char utf8[] = "\xEF\xBB\xBF<pr\xC3\xA4sentation \xE8\xA8\x80\xE8\xAA\x9E=\"\xE6\x97\xA5\xE6\x9C\xAC long enough for whole words \\\" x\">gr\xC3\xBC\xC3\x9F \xF0\x9F\x98\x80</pr\xC3\xA4sentation>";
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[16];
+	struct ijxml_aux_context ctx;
+	char utf16[64], converted[64];
+	unsigned i, n, bom_len;
+	int error;
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, utf8, (unsigned)strlen(utf8), tokens, 16).error == 0);
+	ijxml_aux_init(&ctx, utf8, tokens, parser.toknext);
+
+	XML_ENSURE(tokens[0].start == 3);
+	XML_ENSURE(ijxml_aux_token_equals(&ctx, ijxml_aux_tag(&ctx, 0), "pr\xC3\xA4sentation"));
+	XML_ENSURE(ijxml_aux_token_equals(&ctx, ijxml_aux_object_attribute(&ctx, 0, "\xE8\xA8\x80\xE8\xAA\x9E"), "\xE6\x97\xA5\xE6\x9C\xAC long enough for whole words \\\" x"));
+
+	/* malformed sequences, names starting with a combining mark, invalid UTF-8 in attribute values (only an error when validating) */
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<a\xC3>", 4, tokens, 16).error == 1);
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<\xCC\x80" "a/>", 6, tokens, 16).error == 1);
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<a\xCC\x80/>", 6, tokens, 16).error == 0);
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<a k=\"\xC0\xAF\"/>", 11, tokens, 16).error == TEST_UTF8_ERROR);
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<a k=\"\xED\xA0\x80\"/>", 12, tokens, 16).error == TEST_UTF8_ERROR);
+
+	/* long non-ASCII runs at every alignment, an invalid sequence is found behind them */
+	{
+		static const char *runs[] = {
+			"\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xC3\xA4\xC3\xB6 \xCE\xB1\xCE\xB2",
+			"\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE0\xA4\x85\xED\x9F\xBF\xEF\xBF\xBD\xF0\x9F\x98\x80"
+		};
+		char doc[96];
+		unsigned r, align;
+
+		for (r=0; r != 2; ++r) {
+			for (align=0; align != 4; ++align) {
+				sprintf(doc, "<a k=\"%.*s%s%s\"/>", (int)align, "xyz", runs[r], runs[r]);
+				ijxml_parser_init(&parser);
+				XML_ENSURE(ijxml_parse(&parser, doc, (unsigned)strlen(doc), tokens, 16).error == 0);
+				XML_ENSURE(tokens[3].end - tokens[3].start == align + 2*strlen(runs[r]));
+
+				sprintf(doc, "<a k=\"%.*s%s\xED\xA0\x80%s\"/>", (int)align, "xyz", runs[r], runs[r]);
+				ijxml_parser_init(&parser);
+				XML_ENSURE(ijxml_parse(&parser, doc, (unsigned)strlen(doc), tokens, 16).error == TEST_UTF8_ERROR);
+
+				sprintf(doc, "<a k=\"%.*s%s\xC3\x28%s\"/>", (int)align, "xyz", runs[r], runs[r]);
+				ijxml_parser_init(&parser);
+				XML_ENSURE(ijxml_parse(&parser, doc, (unsigned)strlen(doc), tokens, 16).error == TEST_UTF8_ERROR);
+
+				/* a quote right behind the run still ends the string */
+				sprintf(doc, "<a k=\"%.*s%s\" b=\"%s\"/>", (int)align, "xyz", runs[r], runs[r]);
+				ijxml_parser_init(&parser);
+				XML_ENSURE(ijxml_parse(&parser, doc, (unsigned)strlen(doc), tokens, 16).error == 0 && parser.toknext == 6);
+			}
+		}
+	}
+
+	/* UTF-16 input is detected and converted before parsing */
+	{
+		static const char text[] = "<a b=\"\xC3\xA4\"/>";
+		static const unsigned short units[] = { 0xFEFF, '<', 'a', ' ', 'b', '=', '"', 0xE4, '"', '/', '>', 0xD83D, 0xDE00 };
+
+		n = sizeof(units) / sizeof(units[0]);
+		for (i=0; i != n; ++i) {
+			utf16[2*i] = (char)(units[i] & 0xFF);
+			utf16[2*i+1] = (char)(units[i] >> 8);
+		}
+
+		XML_ENSURE(ijxml_detect_encoding(utf16, 2*n, &bom_len) == IJXML_ENCODING_UTF16LE && bom_len == 2);
+		XML_ENSURE(ijxml_utf16_to_utf8(utf16+bom_len, 2*n-bom_len, IJXML_ENCODING_UTF16LE, converted, 4, &error) == strlen(text)+4);
+		XML_ENSURE(ijxml_utf16_to_utf8(utf16+bom_len, 2*n-bom_len, IJXML_ENCODING_UTF16LE, converted, sizeof(converted), &error) == strlen(text)+4);
+		XML_ENSURE(error == 0);
+		XML_ENSURE(memcmp(converted, text, strlen(text)) == 0 && memcmp(converted+strlen(text), "\xF0\x9F\x98\x80", 4) == 0);
+
+		/* unpaired surrogate */
+		ijxml_utf16_to_utf8(utf16+bom_len, 2*n-bom_len-2, IJXML_ENCODING_UTF16LE, converted, sizeof(converted), &error);
+		XML_ENSURE(error == 1);
+
+		XML_ENSURE(ijxml_detect_encoding("\xEF\xBB\xBF<a/>", 7, &bom_len) == IJXML_ENCODING_UTF8 && bom_len == 3);
+		XML_ENSURE(ijxml_detect_encoding("\0<\0a", 4, &bom_len) == IJXML_ENCODING_UTF16BE && bom_len == 0);
+	}
+}
+
+typedef struct bind_customer {
+	struct ijxml_aux_span name;
+	int age;
+} bind_customer;
+
+typedef struct bind_item {
+	char sku[8];
+	IJXML_AUX_INT64 quantity;
+} bind_item;
+
+typedef struct bind_order {
+	int id;
+	double total;
+	char code[4];
+	struct bind_customer customer;
+	struct bind_item items[2];
+	unsigned num_items;
+	struct ijxml_aux_span note;
+} bind_order;
+
+static const struct ijxml_aux_binding bind_customer_fields[] = {
+	{ "name", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_SPAN, offsetof(bind_customer, name), 0, 0, 0, 0, 0 },
+	{ "age", IJXML_AUX_BIND_ELEMENT, IJXML_AUX_BIND_INT, offsetof(bind_customer, age), 0, 0, 0, 0, 0 },
+};
+
+static const struct ijxml_aux_binding bind_item_fields[] = {
+	{ "sku", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_STRING, offsetof(bind_item, sku), sizeof(((bind_item *)0)->sku), 0, 0, 0, 0 },
+	{ "qty", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_INT64, offsetof(bind_item, quantity), 0, 0, 0, 0, 0 },
+};
+
+static const struct ijxml_aux_binding bind_order_fields[] = {
+	{ "id", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_INT, offsetof(bind_order, id), 0, 0, 0, 0, 0 },
+	{ "total", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_DOUBLE, offsetof(bind_order, total), 0, 0, 0, 0, 0 },
+	{ "code", IJXML_AUX_BIND_ATTRIBUTE, IJXML_AUX_BIND_STRING, offsetof(bind_order, code), sizeof(((bind_order *)0)->code), 0, 0, 0, 0 },
+	{ "customer", IJXML_AUX_BIND_ELEMENT, IJXML_AUX_BIND_STRUCT, offsetof(bind_order, customer), 0, bind_customer_fields, 2, 0, 0 },
+	{ "item", IJXML_AUX_BIND_ELEMENT, IJXML_AUX_BIND_STRUCT, offsetof(bind_order, items), sizeof(bind_item), bind_item_fields, 2, 2, offsetof(bind_order, num_items) },
+	{ "note", IJXML_AUX_BIND_ELEMENT, IJXML_AUX_BIND_SPAN, offsetof(bind_order, note), 0, 0, 0, 0, 0 },
+};
+
+static void test_bind(void)
+{
+	static const char order_xml[] =
+		"<order id=\"42\" total=\"-12.5e1\" code=\"ABCDEF\">"
+			"<customer name=\"Ann\"><age>37</age><age2>1</age2></customer>"
+			"<item sku=\"a\" qty=\"-9000000000\"/>"
+			"<item sku=\"b\" qty=\"2\"><item sku=\"nested\"/></item>"
+			"<item sku=\"c\" qty=\"3\"/>"
+			"<note>hello  world</note>"
+		"</order>";
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[64];
+	struct ijxml_aux_context ctx;
+	struct bind_order order;
+	double d;
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, order_xml, (unsigned)strlen(order_xml), tokens, 64).error == 0);
+	ijxml_aux_init(&ctx, order_xml, tokens, parser.toknext);
+
+	memset(&order, 0, sizeof(order));
+	XML_ENSURE(ijxml_aux_bind(&ctx, 0, bind_order_fields, sizeof(bind_order_fields)/sizeof(bind_order_fields[0]), &order) == IJXML_AUX_BUFFER_TRUNCATED);
+
+	XML_ENSURE(order.id == 42);
+	XML_ENSURE(order.total == -125.0);
+	XML_ENSURE(strcmp(order.code, "ABC") == 0);
+	XML_ENSURE(order.customer.age == 37);
+	XML_ENSURE(order.customer.name.end - order.customer.name.start == 3 && memcmp(order_xml + order.customer.name.start, "Ann", 3) == 0);
+	XML_ENSURE(order.num_items == 2);
+	XML_ENSURE(strcmp(order.items[0].sku, "a") == 0 && order.items[0].quantity == -9000000000LL);
+	XML_ENSURE(strcmp(order.items[1].sku, "b") == 0 && order.items[1].quantity == 2);
+	XML_ENSURE(memcmp(order_xml + order.note.start, "hello  world", order.note.end - order.note.start) == 0);
+
+	/* conversions */
+	XML_ENSURE(ijxml_aux_parse_double("0.25", "0.25" + 4, &d) && d == 0.25);
+	XML_ENSURE(ijxml_aux_parse_double("1e-3", "1e-3" + 4, &d) && d == 0.001);
+	XML_ENSURE(ijxml_aux_parse_double("1.", "1." + 2, &d) && d == 1.0);
+	XML_ENSURE(!ijxml_aux_parse_double("e1", "e1" + 2, &d));
+	{
+		IJXML_AUX_INT64 i64;
+		XML_ENSURE(ijxml_aux_parse_int64("-9223372036854775808", "-9223372036854775808" + 20, &i64) && i64 == -9223372036854775807LL - 1);
+		XML_ENSURE(!ijxml_aux_parse_int64("9223372036854775808", "9223372036854775808" + 19, &i64));
+		XML_ENSURE(!ijxml_aux_parse_int64("12a", "12a" + 3, &i64));
+	}
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, "<order id=\"4x\"/>", 17, tokens, 64).error == 0);
+	ijxml_aux_init(&ctx, "<order id=\"4x\"/>", tokens, parser.toknext);
+	XML_ENSURE(ijxml_aux_bind(&ctx, 0, bind_order_fields, 1, &order) == IJXML_AUX_CONVERSION_FAILED);
+}
+
+static void test_columns(void)
+{
+	static const char table_xml[] =
+		"<table name=\"t\">"
+			"<row a=\"1\" b=\"2.5\" c=\"x\"/>"
+			"<row a=\"2\" c=\"yy\"><b>-0.5</b><b>9</b><row a=\"nested\"/></row>"
+			"<comment a=\"skipped\"/>"
+			"<row a=\"oops\" b=\"1\"/>"
+			"<row/>"
+		"</table>";
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[64];
+	struct ijxml_aux_context ctx;
+	IJXML_AUX_INT64 a[4];
+	double b[4];
+	struct ijxml_aux_span c[4];
+	unsigned char a_valid[1], b_valid[1], c_valid[1];
+	struct ijxml_aux_column columns[3];
+	unsigned num_rows;
+
+	columns[0].name = "a"; columns[0].source = IJXML_AUX_BIND_ATTRIBUTE; columns[0].type = IJXML_AUX_BIND_INT64; columns[0].values = a; columns[0].valid = a_valid;
+	columns[1].name = "b"; columns[1].source = IJXML_AUX_BIND_ELEMENT; columns[1].type = IJXML_AUX_BIND_DOUBLE; columns[1].values = b; columns[1].valid = b_valid;
+	columns[2].name = "c"; columns[2].source = IJXML_AUX_BIND_ATTRIBUTE; columns[2].type = IJXML_AUX_BIND_SPAN; columns[2].values = c; columns[2].valid = c_valid;
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, table_xml, (unsigned)strlen(table_xml), tokens, 64).error == 0);
+	ijxml_aux_init(&ctx, table_xml, tokens, parser.toknext);
+
+	/* 'b' is read from elements, the attribute of the first row does not count; the second row keeps its first 'b', 'a' of the third row does not convert */
+	XML_ENSURE(ijxml_aux_columns(&ctx, 0, "row", columns, 3, 4, &num_rows) == IJXML_AUX_CONVERSION_FAILED);
+	XML_ENSURE(num_rows == 4);
+	XML_ENSURE((a_valid[0] & 0xf) == 0x3 && a[0] == 1 && a[1] == 2 && a[2] == 0 && a[3] == 0);
+	XML_ENSURE((b_valid[0] & 0xf) == 0x2 && b[0] == 0.0 && b[1] == -0.5);
+	XML_ENSURE((c_valid[0] & 0xf) == 0x3 && c[0].end - c[0].start == 1 && memcmp(table_xml + c[1].start, "yy", 2) == 0);
+
+	/* all child elements are rows, too few rows */
+	columns[0].type = IJXML_AUX_BIND_SPAN;
+	columns[0].values = c;
+	XML_ENSURE(ijxml_aux_columns(&ctx, 0, 0, columns, 1, 3, &num_rows) == IJXML_AUX_BUFFER_TRUNCATED);
+	XML_ENSURE(num_rows == 3 && (a_valid[0] & 0x7) == 0x7);
+	XML_ENSURE(memcmp(table_xml + c[2].start, "skipped", 7) == 0);
+
+	/* column types without a column layout are refused */
+	columns[1].type = IJXML_AUX_BIND_INT;
+	XML_ENSURE(ijxml_aux_columns(&ctx, 0, "row", columns, 3, 4, &num_rows) == IJXML_AUX_INVALID_COLUMN && num_rows == 0);
+}
+
+static void test_records(void)
+{
+	static const char stream[] =
+		"<?xml version=\"1.0\"?>\n"
+		"<event id=\"1\"><msg>a &gt; b</msg></event>\n"
+		"<!-- <event id=\"commented\"/> -->\n"
+		"<event id=\"2\" note=\"x > y\"/>\n"
+		"<event id=\"3\"><![CDATA[</event>]]><inner><event/></inner></event>\n"
+		"<event id=\"4\"><unfinished>";
+	static const char *ids[] = { "1", "2", "3" };
+	struct ijxml_parser parser;
+	struct ijxml_token tokens[16];
+	struct ijxml_aux_context ctx;
+	struct ijxml_record record;
+	unsigned pos = 0, num_records = 0, last_pos;
+	int res;
+
+	/* every record is parsed on its own, recycling the token buffer */
+	while ((res = ijxml_next_record(stream, (unsigned)strlen(stream), &pos, &record)) == 1) {
+		const char *record_xml = stream + record.start;
+
+		XML_ENSURE(memcmp(record_xml, "<event", 6) == 0 && stream[record.end-1] == '>');
+
+		ijxml_parser_init(&parser);
+		XML_ENSURE(ijxml_parse(&parser, record_xml, record.end - record.start, tokens, 16).error == 0);
+		ijxml_aux_init(&ctx, record_xml, tokens, parser.toknext);
+		XML_ENSURE(ijxml_aux_token_equals(&ctx, ijxml_aux_object_attribute(&ctx, 0, "id"), ids[num_records]));
+
+		++num_records;
+	}
+
+	XML_ENSURE(num_records == 3);
+
+	/* the unfinished record is left for the next chunk */
+	XML_ENSURE(res == -1);
+	XML_ENSURE(memcmp(stream + pos, "\n<event id=\"4\">", 15) == 0);
+
+	last_pos = 0;
+	XML_ENSURE(ijxml_next_record("<a/>", 1, &last_pos, &record) == -1 && last_pos == 0);
+
+	pos = 0;
+	XML_ENSURE(ijxml_next_record(" <!-- only a comment --> ", 25, &pos, &record) == 0 && pos == 25);
+
+	/* the internal subset of a DOCTYPE may contain '>' */
+	pos = 0;
+	XML_ENSURE(ijxml_next_record("<!DOCTYPE r [<!ELEMENT r ANY>]><r/>", 35, &pos, &record) == 1 && record.start == 31 && record.end == 35);
+}
+
+static void test_budget(void)
+{
+	struct ijxml_parser parser, full_parser;
+	struct ijxml_token tokens[32], full_tokens[32];
+	struct ijxml_token *realloc_tokens = 0;
+	struct ijxml_parse_result res;
+	unsigned xml_len = (unsigned)strlen(xml), num_yields, last_pos, num_tokens;
+
+	ijxml_parser_init(&full_parser);
+	XML_ENSURE(ijxml_parse(&full_parser, xml, xml_len, full_tokens, 32).error == IJXML_PARSE_SUCCESS);
+
+	/* byte budget, every slice continues where the previous one stopped */
+	ijxml_parser_init(&parser);
+	num_yields = last_pos = 0;
+	while ((res = ijxml_parse_budget(&parser, xml, xml_len, tokens, 32, 8, (unsigned)-1)).error == IJXML_PARSE_YIELD) {
+		XML_ENSURE(parser.pos > last_pos);
+		last_pos = parser.pos;
+		++num_yields;
+	}
+
+	XML_ENSURE(res.error == IJXML_PARSE_SUCCESS && num_yields > 4);
+	XML_ENSURE(parser.toknext == full_parser.toknext);
+	XML_ENSURE(memcmp(tokens, full_tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+
+	/* token budget mixed with running out of tokens */
+	ijxml_parser_init(&parser);
+	num_tokens = 1;
+	num_yields = 0;
+	realloc_tokens = (struct ijxml_token*)realloc(realloc_tokens, num_tokens * sizeof(struct ijxml_token));
+	for (;;) {
+		res = ijxml_parse_budget(&parser, xml, xml_len, realloc_tokens, num_tokens, (unsigned)-1, 2);
+		if (res.error == IJXML_PARSE_YIELD) {
+			++num_yields;
+		} else if (res.error == IJXML_PARSE_ERROR) {
+			num_tokens += 3;
+			realloc_tokens = (struct ijxml_token*)realloc(realloc_tokens, num_tokens * sizeof(struct ijxml_token));
+		} else {
+			break;
+		}
+	}
+
+	XML_ENSURE(num_yields > 4);
+	XML_ENSURE(parser.toknext == full_parser.toknext);
+	XML_ENSURE(memcmp(realloc_tokens, full_tokens, sizeof(struct ijxml_token)*parser.toknext) == 0);
+
+	free(realloc_tokens);
+
+	/* a plain ijxml_parse finishes a yielded parse */
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse_budget(&parser, xml, xml_len, tokens, 32, 1, 1).error == IJXML_PARSE_YIELD);
+	XML_ENSURE(ijxml_parse(&parser, xml, xml_len, tokens, 32).error == IJXML_PARSE_SUCCESS);
+	XML_ENSURE(memcmp(tokens, full_tokens, sizeof(struct ijxml_token)*full_parser.toknext) == 0);
+}
+
 int main(int args, char **argv)
 {
 	(void)args;
@@ -196,6 +976,30 @@ int main(int args, char **argv)
 	test_reallocation_parsing();
 
 	test_reallocation();
+
+#if defined(IJXML_NAMESPACES)
+	test_namespaces();
+#endif
+
+	test_reparse();
+
+	test_index();
+
+	test_writer();
+
+	test_rewrite();
+
+	test_canonicalize();
+
+	test_utf8();
+
+	test_bind();
+
+	test_columns();
+
+	test_records();
+
+	test_budget();
 	//system("pause");
 
 	return 0;
@@ -0,0 +1,99 @@
+#define IJXML_AUX_IMPLEMENTATION
+#include "ijxml.hpp"
+
+extern "C" {
+#define IJXML_IMPLEMENTATION
+#include "ijxml.h"
+}
+
+#include <string.h>		/* strlen, strcpy */
+
+#include <assert.h>
+
+#define XML_ENSURE(cond) assert((cond))
+
+static const char xml[] =
+	"<root a=\"1\" b=\"two\">"
+		"<item k=\"1\">hello world</item>"
+		" mid "
+		"<other/>"
+		"<item k=\"2\"><sub/></item>"
+	"</root>";
+
+static void test_children(const ijxml_aux_context &ctx)
+{
+	const char *tags[] = { "item", "other", "item" };
+	ijxml::node root = ijxml::root(ctx);
+	unsigned n = 0;
+
+	XML_ENSURE(root && root.is("root"));
+	XML_ENSURE(root.xml() == xml);
+
+	/* siblings only, '<sub/>' is a grandchild */
+	for (ijxml::node child : root.children()) {
+		XML_ENSURE(n < 3 && child.tag() == tags[n]);
+		++n;
+	}
+	XML_ENSURE(n == 3);
+
+	XML_ENSURE(root.child("item").find_attribute("k").value() == "1");
+	XML_ENSURE(root.child("other").children().empty());
+	XML_ENSURE(!root.child("sub"));
+	XML_ENSURE(!root.child("nope"));
+
+	/* names from buffers are as long as their text, not their array */
+	{
+		char name[16];
+		strcpy(name, "other");
+		XML_ENSURE(root.child(name));
+	}
+
+	XML_ENSURE(ijxml::hash("other") == ijxml_hash(IJXML_HASH_SEED, "other", 5));
+	switch (root.child("other").tag_hash()) {
+		case ijxml::hash("other"): break;
+		default: XML_ENSURE(0);
+	}
+}
+
+static void test_attributes(const ijxml_aux_context &ctx)
+{
+	ijxml::node root = ijxml::root(ctx);
+	unsigned n = 0;
+
+	for (ijxml::attribute a : root.attributes()) {
+		XML_ENSURE(n != 0 || (a.key() == "a" && a.value() == "1"));
+		XML_ENSURE(n != 1 || (a.key() == "b" && a.value() == "two"));
+		++n;
+	}
+	XML_ENSURE(n == 2);
+
+	XML_ENSURE(root.find_attribute("b").value() == "two");
+	XML_ENSURE(!root.find_attribute("c"));
+	XML_ENSURE(root.child("other").attributes().empty());
+}
+
+static void test_text(const ijxml_aux_context &ctx)
+{
+	ijxml::node root = ijxml::root(ctx);
+
+	XML_ENSURE(root.child("item").text() == "hello world");
+	XML_ENSURE(root.text() == "mid");
+	XML_ENSURE(root.child("other").text().empty());
+}
+
+int main(int, char **)
+{
+	ijxml_parser parser;
+	ijxml_token tokens[64];
+	ijxml_aux_context ctx;
+
+	ijxml_parser_init(&parser);
+	XML_ENSURE(ijxml_parse(&parser, xml, (unsigned)strlen(xml), tokens, 64).error == 0);
+	ijxml_aux_init(&ctx, xml, tokens, parser.toknext);
+
+	test_children(ctx);
+	test_attributes(ctx);
+	test_text(ctx);
+
+	return 0;
+}
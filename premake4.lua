@@ -44,3 +44,28 @@ solution "ijxml"
 		language "C"
 		files { "*.c", "*.h" }
 		excludes { }
+
+	project "ijxml_test_ns"
+		location ".build"
+		kind "ConsoleApp"
+		uuid (os.uuid("ijxml_test_ns"))
+
+		language "C"
+		files { "*.c", "*.h" }
+		excludes { }
+		defines { "IJXML_NAMESPACES", "IJXML_VALIDATE_UTF8", "IJXML_HASH64" }
+
+	project "ijxml_test_cpp"
+		location ".build"
+		kind "ConsoleApp"
+		uuid (os.uuid("ijxml_test_cpp"))
+
+		language "C++"
+		files { "*.cpp", "*.hpp", "*.h" }
+		excludes { }
+
+		configuration { "gmake" }
+			buildoptions { "-std=c++17" }
+
+		configuration { "vs*" }
+			buildoptions { "/std:c++17" }